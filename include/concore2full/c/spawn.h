@@ -1,6 +1,8 @@
 #ifndef __CONCORE2FULL_SPAWN_H__
 #define __CONCORE2FULL_SPAWN_H__
 
+#include "concore2full/c/stack_allocator.h"
+
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -10,7 +12,7 @@ extern "C" {
 //! Data needed to perform a `spawn` operation.
 //! Must be at least the size that the implementation expects.
 struct concore2full_spawn_frame {
-  void* data[10];
+  void* data[12];
 };
 
 //! Data needed to perform a `bulk_spawn` operation.
@@ -28,6 +30,11 @@ typedef void (*concore2full_bulk_spawn_function_t)(struct concore2full_bulk_spaw
 //! Asynchronously executes `f`, using the given `frame` to hold the state.
 void concore2full_spawn(struct concore2full_spawn_frame* frame, concore2full_spawn_function_t f);
 
+//! Same as `concore2full_spawn`, but uses `salloc` to allocate the stack of the coroutine.
+void concore2full_spawn_with_allocator(struct concore2full_spawn_frame* frame,
+                                       concore2full_spawn_function_t f,
+                                       const struct concore2full_stack_allocator* salloc);
+
 //! Await the async computation represented by `frame` to be finished.
 void concore2full_await(struct concore2full_spawn_frame* frame);
 
@@ -39,6 +46,11 @@ uint64_t concore2full_frame_size(int32_t count);
 void concore2full_bulk_spawn(struct concore2full_bulk_spawn_frame* frame, int32_t count,
                              concore2full_bulk_spawn_function_t f);
 
+//! Same as `concore2full_bulk_spawn`, but uses `salloc` to allocate the stacks of the coroutines.
+void concore2full_bulk_spawn_with_allocator(struct concore2full_bulk_spawn_frame* frame,
+                                            int32_t count, concore2full_bulk_spawn_function_t f,
+                                            const struct concore2full_stack_allocator* salloc);
+
 //! Await the async computations represented by `frame` to be finished.
 void concore2full_bulk_await(struct concore2full_bulk_spawn_frame* frame);
 
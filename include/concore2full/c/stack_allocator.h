@@ -0,0 +1,52 @@
+#ifndef __CONCORE2FULL_STACK_ALLOCATOR_H__
+#define __CONCORE2FULL_STACK_ALLOCATOR_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! The memory space for the stack of a coroutine.
+//! The stack memory spans from `sp_ - size_` to `sp_`.
+struct concore2full_stack {
+  //! The size of the stack memory.
+  uint64_t size_;
+  //! Pointer to the end of the stack memory (stacks grow downwards).
+  void* sp_;
+};
+
+struct concore2full_stack_allocator;
+
+//! Type of a function that allocates a coroutine stack.
+typedef struct concore2full_stack (*concore2full_stack_allocate_function_t)(
+    struct concore2full_stack_allocator* self);
+
+//! Type of a function that deallocates a coroutine stack.
+typedef void (*concore2full_stack_deallocate_function_t)(struct concore2full_stack_allocator* self,
+                                                         struct concore2full_stack stack);
+
+//! An allocator for the stacks of the coroutines created by spawn operations.
+//! The allocator object is copied by value; the state of the allocator needs to fit in `data_`.
+//! The stacks may be deallocated on a different thread than the one that allocated them.
+struct concore2full_stack_allocator {
+  //! The function called to allocate a stack.
+  concore2full_stack_allocate_function_t allocate_fn_;
+  //! The function called to deallocate a stack.
+  concore2full_stack_deallocate_function_t deallocate_fn_;
+  //! The state of the allocator.
+  void* data_;
+};
+
+//! Returns an allocator that allocates stacks of `size` bytes with `malloc`.
+struct concore2full_stack_allocator concore2full_simple_stack_allocator(uint64_t size);
+
+//! Returns an allocator that maps stacks of `size` bytes (rounded up to the page size) directly from
+//! the OS, committing memory only when touched, and placing a guard page below each stack.
+struct concore2full_stack_allocator concore2full_mmap_stack_allocator(uint64_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
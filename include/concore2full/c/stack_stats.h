@@ -0,0 +1,41 @@
+#ifndef __CONCORE2FULL_STACK_STATS_H__
+#define __CONCORE2FULL_STACK_STATS_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Statistics about the coroutine stacks.
+struct concore2full_stack_stats {
+  //! The number of stacks used by live coroutines.
+  uint64_t live_stacks_;
+  //! The maximum value of `live_stacks_` since the start (or the last peak reset).
+  uint64_t peak_live_stacks_;
+  //! The number of bytes reserved for the stacks of live coroutines.
+  uint64_t live_bytes_;
+  //! The maximum value of `live_bytes_` since the start (or the last peak reset).
+  uint64_t peak_live_bytes_;
+  //! The number of free stacks kept by the stack allocators for reuse.
+  uint64_t cached_stacks_;
+  //! The number of bytes of the free stacks kept by the stack allocators for reuse.
+  uint64_t cached_bytes_;
+  //! The total number of coroutine stacks allocated so far.
+  uint64_t total_allocations_;
+  //! The time at which the statistics were taken, in nanoseconds, from an arbitrary epoch.
+  uint64_t timestamp_ns_;
+};
+
+//! Fills `stats` with the current statistics about the coroutine stacks.
+void concore2full_get_stack_stats(struct concore2full_stack_stats* stats);
+
+//! Returns the number of stack allocations per second between the two given statistics.
+double concore2full_stack_allocation_rate(const struct concore2full_stack_stats* older,
+                                          const struct concore2full_stack_stats* newer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
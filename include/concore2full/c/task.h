@@ -21,7 +21,8 @@ struct concore2full_task {
   //! Pointer to the `next_` field of the previous element in the list of tasks; implementation
   //! details.
   struct concore2full_task** prev_link_;
-  //! The worker data for the task; implementation details.
+  //! The worker data for the task; implementation details. While the task is enqueued, this is
+  //! atomically reset to claim the task for execution or extraction.
   void* worker_data_;
 };
 
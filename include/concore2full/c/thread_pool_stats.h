@@ -0,0 +1,36 @@
+#ifndef __CONCORE2FULL_THREAD_POOL_STATS_H__
+#define __CONCORE2FULL_THREAD_POOL_STATS_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Statistics about the scheduling of tasks in a thread pool.
+struct concore2full_thread_pool_stats {
+  //! The number of tasks executed.
+  uint64_t tasks_executed_;
+  //! The number of tasks taken from the work line or the deque of another thread.
+  uint64_t tasks_stolen_;
+  //! The number of attempts to pop a task from a work line that failed because the line was locked.
+  uint64_t pops_contended_;
+  //! The number of attempts to pop a task from a work line that failed because the line was empty.
+  uint64_t pops_empty_;
+  //! The number of times threads went to sleep, waiting for tasks.
+  uint64_t sleeps_;
+  //! The number of times threads woke up sleeping threads.
+  uint64_t wakeups_;
+  //! The number of tasks that were extracted before being executed.
+  uint64_t tasks_extracted_;
+};
+
+//! Fills `stats` with the current scheduling statistics of the global thread pool.
+//! If the statistics are compiled out, all the values are zero.
+void concore2full_get_thread_pool_stats(struct concore2full_thread_pool_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -4,11 +4,17 @@
 #include "concore2full/c/task.h"
 #include "concore2full/detail/catomic.h"
 #include "concore2full/detail/core_types.h"
+#include "concore2full/stack/any_stack_allocator.h"
 #include "concore2full/this_thread.h"
+#include "concore2full/worker_affinity.h"
 
 #include <memory>
 #include <type_traits>
 
+namespace concore2full {
+class thread_pool;
+}
+
 namespace concore2full::detail {
 
 struct concore2full_bulk_spawn_task;
@@ -28,8 +34,19 @@ struct bulk_spawn_frame_base {
   //! Returns the frame size we need for storing this object, given the number of work items.
   static uint64_t frame_size(int32_t count);
 
-  //! Asynchronously executes `f` for indices in range [0, `count`).
-  void spawn(int32_t count, concore2full_bulk_spawn_function_t f);
+  //! Asynchronously executes `f` for indices in range [0, `count`), using `salloc` to allocate the
+  //! stacks of the coroutines.
+  void spawn(int32_t count, concore2full_bulk_spawn_function_t f,
+             stack::any_stack_allocator salloc = {});
+
+  //! Same as above, but work item `i` is preferably executed by worker `i % N`, where `N` is the
+  //! number of worker threads.
+  void spawn(int32_t count, concore2full_bulk_spawn_function_t f, stack::any_stack_allocator salloc,
+             round_robin_workers_t);
+
+  //! Same as above, but the work items are enqueued in `pool`, instead of the global thread pool.
+  void spawn(int32_t count, concore2full_bulk_spawn_function_t f, stack::any_stack_allocator salloc,
+             thread_pool& pool);
 
   //! Await the async computation started by `spawn` to be finished.
   void await();
@@ -50,6 +67,12 @@ public:
   //! The user function to be called to execute the async work.
   concore2full_bulk_spawn_function_t user_function_;
 
+  //! The allocator used for the stacks of the coroutines.
+  stack::any_stack_allocator stack_allocator_;
+
+  //! The thread pool in which the work items are enqueued.
+  thread_pool* pool_;
+
   //! The tasks for each work item.
   concore2full_bulk_spawn_task* tasks_;
 
@@ -60,6 +83,10 @@ public:
   // More data will follow here, depending on the number of work items.
 
 private:
+  //! Prepares the frame to execute `f` for `count` work items on `pool`, before enqueueing the
+  //! tasks.
+  void prepare(int32_t count, concore2full_bulk_spawn_function_t f,
+               stack::any_stack_allocator salloc, thread_pool& pool);
   //! Called by the spawned tasks to store the continuation back to the worker pool.
   int store_worker_continuation(continuation_t c);
   //! Extract a continuation stored by a worker thread.
@@ -6,6 +6,7 @@
 
 #include <functional>
 #include <memory>
+#include <utility>
 
 namespace concore2full::detail {
 
@@ -19,8 +20,12 @@ template <typename Fn> struct bulk_spawn_frame_full {
 
   using result_t = void;
 
-  void spawn() {
-    base_frame_.spawn(base_frame_.count_, &detail::bulk_spawn_frame_full<Fn>::to_execute);
+  void spawn(stack::any_stack_allocator salloc = {}) {
+    base_frame_.spawn(base_frame_.count_, &detail::bulk_spawn_frame_full<Fn>::to_execute, salloc);
+  }
+  template <typename H> void spawn(stack::any_stack_allocator salloc, H&& hint) {
+    base_frame_.spawn(base_frame_.count_, &detail::bulk_spawn_frame_full<Fn>::to_execute, salloc,
+                      std::forward<H>(hint));
   }
   void await() { base_frame_.await(); }
 
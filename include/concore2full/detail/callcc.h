@@ -4,7 +4,7 @@
 #include "concore2full/detail/core_types.h"
 #include "concore2full/detail/create_stackfull_coroutine.h"
 #include "concore2full/profiling.h"
-#include "concore2full/stack/simple_stack_allocator.h"
+#include "concore2full/stack/pooled_stack_allocator.h"
 #include "concore2full/stack/stack_allocator.h"
 
 #include <context_core_api.h>
@@ -35,7 +35,8 @@ inline continuation_t callcc(std::allocator_arg_t, stack::stack_allocator auto&&
 /// The return continuation of the given function will be used to call the destruction of the
 /// stackfull coroutine.
 ///
-/// If stack allocator is not provided, a default `simple_stack_allocator` will be used.
+/// If stack allocator is not provided, a default `pooled_stack_allocator` will be used, taking the
+/// stacks from `default_stack_pool()`.
 ///
 /// @sa resume()
 inline continuation_t callcc(std::allocator_arg_t, stack::stack_allocator auto&& salloc,
@@ -45,7 +46,7 @@ inline continuation_t callcc(std::allocator_arg_t, stack::stack_allocator auto&&
                                             std::forward<decltype(f)>(f));
 }
 inline continuation_t callcc(context_function auto&& f) {
-  return callcc(std::allocator_arg, stack::simple_stack_allocator(), std::forward<decltype(f)>(f));
+  return callcc(std::allocator_arg, stack::pooled_stack_allocator(), std::forward<decltype(f)>(f));
 }
 
 //! Resumes the given continuation.
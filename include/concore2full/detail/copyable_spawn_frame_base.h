@@ -5,12 +5,17 @@
 #include "concore2full/detail/callcc.h"
 #include "concore2full/detail/value_holder.h"
 #include "concore2full/profiling_atomic.h"
+#include "concore2full/stack/any_stack_allocator.h"
 #include "concore2full/suspend.h"
 #include "concore2full/this_thread.h"
 
 #include <memory>
 #include <type_traits>
 
+namespace concore2full {
+class thread_pool;
+}
+
 namespace concore2full::detail {
 
 //! Basic structure needed to perform a `spawn` operation.
@@ -25,8 +30,8 @@ struct copyable_spawn_frame_base {
   }
   interface_t* to_interface() { return reinterpret_cast<interface_t*>(this); }
 
-  //! Asynchronously executes `f`.
-  void spawn(concore2full_spawn_function_t f);
+  //! Asynchronously executes `f`, using `salloc` to allocate the stack of the coroutine.
+  void spawn(concore2full_spawn_function_t f, stack::any_stack_allocator salloc = {});
 
   //! Await the async computation started by `spawn` to be finished.
   void await();
@@ -52,6 +57,12 @@ private:
   //! Token that will wake any suspended threads of execution.
   suspend_token suspend_token_;
 
+  //! The allocator used for the stacks of the coroutines.
+  stack::any_stack_allocator stack_allocator_;
+
+  //! The thread pool in which the work is enqueued.
+  thread_pool* pool_{nullptr};
+
 private:
   //! Called when the spawned work is completed.
   continuation_t on_async_complete(continuation_t c);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace concore2full::detail {
+
+//! The position of a logical CPU in the topology of the machine.
+struct cpu_info {
+  //! The index of the logical CPU (as in `cpu<N>`).
+  int cpu_{0};
+  //! The ID of the physical core; SMT siblings share the same core (and package).
+  int core_id_{-1};
+  //! The ID of the physical package (socket).
+  int package_id_{-1};
+  //! The ID of the L3 cache domain; -1 if unknown.
+  int l3_id_{-1};
+  //! The NUMA node of the CPU; -1 if unknown.
+  int node_id_{-1};
+};
+
+/**
+ * @brief Reads the topology of the online CPUs that the current thread can run on.
+ * @param sysfs_cpu_root The directory describing the CPUs; normally `/sys/devices/system/cpu`.
+ * @return The CPUs, ordered by their index; empty if the topology cannot be read.
+ *
+ * Only the CPUs in the affinity mask of the current thread are returned. If `sysfs_cpu_root`
+ * doesn't point to the system directory, the affinity mask is ignored; this is useful for testing.
+ */
+std::vector<cpu_info>
+read_cpu_topology(const std::string& sysfs_cpu_root = "/sys/devices/system/cpu");
+
+//! Returns how far apart two CPUs are: 0 for the same CPU, 1 for SMT siblings, 2 for CPUs sharing
+//! an L3 cache, 3 for CPUs on the same NUMA node (or package), and 4 for remote CPUs.
+int cpu_distance(const cpu_info& a, const cpu_info& b) noexcept;
+
+//! Given the CPUs that the workers are pinned to (`worker_cpus[i]` for worker `i`), returns for
+//! worker `self` the other workers, ordered from the closest to the farthest. Workers with the same
+//! distance are ordered starting after `self`, to spread the stealing.
+std::vector<int> topology_steal_order(const std::vector<cpu_info>& worker_cpus, int self);
+
+//! Pins the current thread to the given CPU. Returns `false` if the thread cannot be pinned.
+bool pin_current_thread_to_cpu(int cpu) noexcept;
+
+} // namespace concore2full::detail
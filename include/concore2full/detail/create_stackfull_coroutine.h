@@ -17,12 +17,16 @@ inline auto allocate_stack(stack::stack_allocator auto&& allocator, context_func
   using control_t = stack_control_structure<decltype(allocator), decltype(f)>;
   // Allocate the stack.
   stack::stack_t stack = allocator.allocate();
+  on_stack_acquired(stack.size);
   // Put the control structure on the stack, at the end of the allocated space.
   uintptr_t align = alignof(control_t);
   void* p = reinterpret_cast<void*>(
       (reinterpret_cast<uintptr_t>(stack.sp) - static_cast<uintptr_t>(sizeof(control_t))) & ~align);
-  return new (p)
+  auto* control = new (p)
       control_t{stack, std::forward<decltype(allocator)>(allocator), std::forward<decltype(f)>(f)};
+  // If requested, prepare the stack for measuring its usage.
+  control->usage_histogram_ = start_stack_usage_sampling(stack, control);
+  return control;
 };
 
 /// @brief Called to finish the execution in the coroutine
@@ -6,6 +6,7 @@
 
 #include <memory>
 #include <type_traits>
+#include <utility>
 
 namespace concore2full::detail {
 
@@ -26,6 +27,14 @@ struct frame_with_value : FrameBase, value_holder<std::invoke_result_t<Fn>> {
   //! Spawn the computation, that will execute `f_`.
   void spawn() { FrameBase::spawn(&to_execute); }
 
+  //! Spawn the computation, that will execute `f_`, using `salloc` to allocate the stack.
+  void spawn(stack::any_stack_allocator salloc) { FrameBase::spawn(&to_execute, salloc); }
+
+  //! Spawn the computation, that will execute `f_`, passing `hint` to the thread pool.
+  template <typename H> void spawn(stack::any_stack_allocator salloc, H&& hint) {
+    FrameBase::spawn(&to_execute, salloc, std::forward<H>(hint));
+  }
+
   //! Await the result of the computation.
   result_t await() {
     FrameBase::await();
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "concore2full/c/spawn.h"
+#include "concore2full/c/task.h"
+#include "concore2full/suspend.h"
+
+#include <atomic>
+
+namespace concore2full {
+class thread_pool;
+}
+
+namespace concore2full::detail {
+
+//! Basic structure needed to perform a `spawn` operation that doesn't allocate a stack upfront.
+//!
+//! The spawned work is executed directly on the stack of the worker thread that picks it up. If
+//! the work finishes before `await` is called (or if `await` executes the work inline), no
+//! coroutine is ever created. Only if `await` arrives first, the awaiting thread suspends (creating
+//! a continuation) and offers its help to the thread pool until the work is done.
+struct lazy_spawn_frame_base {
+
+  using interface_t = concore2full_spawn_frame;
+
+  lazy_spawn_frame_base() = default;
+
+  static lazy_spawn_frame_base* from_interface(interface_t* src) {
+    return reinterpret_cast<lazy_spawn_frame_base*>(src);
+  }
+  interface_t* to_interface() { return reinterpret_cast<interface_t*>(this); }
+
+  //! Asynchronously executes `f`. This doesn't take a stack allocator: the work runs on the stack of
+  //! the worker thread, and if `await` needs to suspend, the continuation is created with the
+  //! default stack allocator.
+  void spawn(concore2full_spawn_function_t f);
+
+  //! Await the async computation started by `spawn` to be finished.
+  void await();
+
+private:
+  //! Describes how to view the spawn data as a task.
+  struct concore2full_task task_;
+
+  //! The state of the computation, with respect to reaching the await point.
+  std::atomic<uint32_t> sync_state_;
+
+  //! The user function to be called to execute the async work.
+  concore2full_spawn_function_t user_function_;
+
+  //! Token used to wake up the awaiting thread, if it arrives before the work is done.
+  suspend_token suspend_token_;
+
+  //! The thread pool in which the work is enqueued.
+  thread_pool* pool_{nullptr};
+
+private:
+  //! The task function that executes the spawned work.
+  static void execute_spawn_task(concore2full_task* task, int) noexcept;
+};
+
+} // namespace concore2full::detail
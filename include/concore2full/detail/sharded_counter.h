@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+
+namespace concore2full::detail {
+
+/**
+ * @brief A counter split into multiple shards, to reduce contention between threads.
+ *
+ * Each shard lives in its own cache line. Threads update the shard that corresponds to them (e.g.,
+ * the index of the worker thread), so that concurrent updates from different threads don't fight
+ * over the same cache line. The value of the counter is the sum of all the shards; individual
+ * shards can become negative, if values are added on one shard and subtracted on another.
+ *
+ * Reading the value visits all the shards, so it's more expensive than updating it. The value is
+ * not an atomic snapshot: an update can be observed while an earlier update on a shard that was
+ * already visited is not. With `std::memory_order_seq_cst`, every update that precedes the read
+ * in the single total order, and every update that precedes the read of its shard, is observed.
+ *
+ * For frequent checks, the counter also keeps a cheap summary: `maybe_positive()` is set by every
+ * positive update, and cleared only by `recount()`, when the sum is not positive. Thus, if the
+ * value is positive, `maybe_positive()` eventually returns `true`; the reverse doesn't hold.
+ */
+class sharded_counter {
+public:
+  //! Constructor. Creates a counter with `num_shards` shards, all zero.
+  explicit sharded_counter(int num_shards)
+      : num_shards_(num_shards), shards_(std::make_unique<shard[]>(num_shards)) {
+    assert(num_shards > 0);
+  }
+
+  sharded_counter(const sharded_counter&) = delete;
+  sharded_counter& operator=(const sharded_counter&) = delete;
+
+  //! Adds `value` to the shard with index `shard_index` (taken modulo the number of shards).
+  void add(int shard_index, int64_t value,
+           std::memory_order order = std::memory_order_seq_cst) noexcept {
+    shards_[static_cast<unsigned>(shard_index) % num_shards_].value_.fetch_add(value, order);
+    // Sync: seq_cst: pairs with `recount()`; either it sees our update, or we see the cleared
+    // summary. Don't write the summary if it's already set, to keep its cache line shared.
+    if (value > 0 && !maybe_positive_.load(std::memory_order_seq_cst))
+      maybe_positive_.store(true, std::memory_order_seq_cst);
+  }
+
+  //! Returns `false` if the value was not positive at the last `recount()`, and no positive update
+  //! happened since. Reads a single word.
+  bool maybe_positive() const noexcept { return maybe_positive_.load(std::memory_order_relaxed); }
+
+  //! Clears the summary, then returns the sum of all the shards, read with `seq_cst`. If the sum is
+  //! positive, sets the summary again.
+  int64_t recount() noexcept {
+    maybe_positive_.store(false, std::memory_order_seq_cst);
+    int64_t sum = load(std::memory_order_seq_cst);
+    if (sum > 0)
+      maybe_positive_.store(true, std::memory_order_seq_cst);
+    return sum;
+  }
+
+  //! Returns the value of the counter, i.e., the sum of all the shards.
+  int64_t load(std::memory_order order = std::memory_order_seq_cst) const noexcept {
+    int64_t sum = 0;
+    for (int i = 0; i < num_shards_; i++)
+      sum += shards_[i].value_.load(order);
+    return sum;
+  }
+
+  //! Returns the number of shards.
+  int num_shards() const noexcept { return num_shards_; }
+
+private:
+  //! One shard of the counter, aligned to a cache line.
+  struct alignas(64) shard {
+    std::atomic<int64_t> value_{0};
+  };
+
+  //! The number of shards.
+  const int num_shards_;
+  //! The shards of the counter.
+  std::unique_ptr<shard[]> shards_;
+  //! Summary of the value; see `maybe_positive()`. In its own cache line, as it's mostly read.
+  alignas(64) std::atomic<bool> maybe_positive_{false};
+};
+
+} // namespace concore2full::detail
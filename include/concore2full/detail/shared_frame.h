@@ -13,7 +13,7 @@ template <typename Frame> struct shared_frame {
   explicit shared_frame(Ts&&... args)
       : frame_(std::make_shared<Frame>(std::forward<Ts>(args)...)) {}
 
-  void spawn() { frame_->spawn(); }
+  template <typename... Ts> void spawn(Ts&&... args) { frame_->spawn(std::forward<Ts>(args)...); }
 
   result_t await() { return frame_->await(); }
 
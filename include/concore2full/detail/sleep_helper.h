@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <stdint.h>
 
 namespace concore2full::detail {
@@ -51,6 +52,10 @@ struct sleep_helper {
 
   void sleep();
 
+  //! Same as `sleep()`, but doesn't sleep past `deadline`.
+  //! Returns `true` if the thread was woken up, and `false` on timeout.
+  bool sleep_until(std::chrono::steady_clock::time_point deadline);
+
   //! Get a token that can wake up the thread that we are putting to sleep.
   wakeup_token get_wakeup_token();
 
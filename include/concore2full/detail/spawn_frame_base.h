@@ -4,13 +4,25 @@
 #include "concore2full/c/task.h"
 #include "concore2full/detail/callcc.h"
 #include "concore2full/detail/value_holder.h"
+#include "concore2full/stack/any_stack_allocator.h"
+#include "concore2full/task_priority.h"
+#include "concore2full/worker_affinity.h"
 #include "concore2full/this_thread.h"
 
 #include <memory>
 #include <type_traits>
 
+namespace concore2full {
+class thread_pool;
+}
+
 namespace concore2full::detail {
 
+//! Hint to enqueue spawned work in `pool_`, respecting the capacity of the pool.
+struct bounded_pool_hint {
+  thread_pool* pool_;
+};
+
 //! Basic structure needed to perform a `spawn` operation.
 struct spawn_frame_base {
 
@@ -23,8 +35,27 @@ struct spawn_frame_base {
   }
   interface_t* to_interface() { return reinterpret_cast<interface_t*>(this); }
 
-  //! Asynchronously executes `f`.
-  void spawn(concore2full_spawn_function_t f);
+  //! Asynchronously executes `f`, using `salloc` to allocate the stack of the coroutine.
+  //! The work is enqueued in the thread pool with the given `priority`.
+  void spawn(concore2full_spawn_function_t f, stack::any_stack_allocator salloc = {},
+             task_priority priority = task_priority::normal);
+
+  //! Asynchronously executes `f`, using `salloc` to allocate the stack of the coroutine.
+  //! The work is enqueued in the thread pool to be preferably executed by the worker indicated by
+  //! `affinity`.
+  void spawn(concore2full_spawn_function_t f, stack::any_stack_allocator salloc,
+             worker_affinity affinity);
+
+  //! Asynchronously executes `f`, using `salloc` to allocate the stack of the coroutine.
+  //! The work is enqueued in `pool`, instead of the global thread pool.
+  void spawn(concore2full_spawn_function_t f, stack::any_stack_allocator salloc,
+             thread_pool& pool);
+
+  //! Asynchronously executes `f`, using `salloc` to allocate the stack of the coroutine.
+  //! The work is enqueued with `thread_pool::enqueue_bounded()` in the pool given by `hint`; if the
+  //! pool rejects it, the work is executed by `await()`.
+  void spawn(concore2full_spawn_function_t f, stack::any_stack_allocator salloc,
+             bounded_pool_hint hint);
 
   //! Await the async computation started by `spawn` to be finished.
   void await();
@@ -45,7 +76,16 @@ private:
   //! The user function to be called to execute the async work.
   concore2full_spawn_function_t user_function_;
 
+  //! The allocator used for the stacks of the coroutines.
+  stack::any_stack_allocator stack_allocator_;
+
+  //! The thread pool in which the work is enqueued.
+  thread_pool* pool_{nullptr};
+
 private:
+  //! Prepares the frame to execute `f` on `pool`, before enqueueing it.
+  void prepare(concore2full_spawn_function_t f, stack::any_stack_allocator salloc,
+               thread_pool& pool);
   //! Called when the spawned work is completed.
   continuation_t on_async_complete(continuation_t c);
   //! The task function that executes the spawned work.
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+
+namespace concore2full::detail {
+
+//! Records that a stack of `size` bytes started to be used by a coroutine.
+void on_stack_acquired(std::size_t size) noexcept;
+//! Records that a stack of `size` bytes is no longer used by a coroutine.
+void on_stack_released(std::size_t size) noexcept;
+
+//! Records that an allocator keeps `count` free stacks of `size` bytes for reuse.
+void on_stacks_cached(std::size_t count, std::size_t size) noexcept;
+//! Records that an allocator no longer keeps `count` free stacks of `size` bytes.
+void on_stacks_uncached(std::size_t count, std::size_t size) noexcept;
+
+} // namespace concore2full::detail
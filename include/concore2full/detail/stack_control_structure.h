@@ -2,6 +2,8 @@
 
 #include "concore2full/detail/context_function.h"
 #include "concore2full/detail/core_types.h"
+#include "concore2full/detail/stack_accounting.h"
+#include "concore2full/detail/stack_usage_sampling.h"
 
 #include "concore2full/stack/stack_allocator.h"
 
@@ -24,15 +26,20 @@ template <stack::stack_allocator S, context_function F> struct stack_control_str
   std::decay_t<S> allocator_;
   /// The main function to run in this new context.
   std::decay_t<F> main_function_;
+  /// The histogram in which we record the stack usage; null if the stack usage is not sampled.
+  stack::stack_usage_histogram* usage_histogram_{nullptr};
 
   /// @brief  Destroys the stackfull coroutine.
   /// @param record Pointer to this, indicating the coroutine to be destroyed.
   ///
   /// This will destroy this object and deallocate the stack.
   friend void destroy(stack_control_structure* record) {
-    // Save needed data.
-    S allocator = std::move(record->allocator_);
+    // Save needed data; copy the allocator out of the stack memory that is going to be released.
+    std::decay_t<S> allocator = std::move(record->allocator_);
     stack::stack_t stack = record->stack_;
+    if (record->usage_histogram_)
+      finish_stack_usage_sampling(record->usage_histogram_, stack);
+    on_stack_released(stack.size);
     // Destruct the object.
     record->~stack_control_structure();
     // Destroy the stack.
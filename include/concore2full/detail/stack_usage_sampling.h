@@ -0,0 +1,21 @@
+#pragma once
+
+#include "concore2full/stack/stack_allocator.h"
+#include "concore2full/stack/stack_usage.h"
+
+namespace concore2full::detail {
+
+/// @brief Starts sampling the stack usage for a newly created coroutine, if sampling is enabled.
+/// @param stack The stack of the coroutine.
+/// @param used_end The lowest address of the stack that is already in use.
+/// @return The histogram in which the usage needs to be recorded, or null if not sampling.
+///
+/// This fills the unused part of the stack with a canary pattern.
+stack::stack_usage_histogram* start_stack_usage_sampling(stack::stack_t stack, void* used_end);
+
+/// @brief Records the high-water mark of a coroutine stack.
+/// @param histogram The histogram returned by `start_stack_usage_sampling`.
+/// @param stack The stack of the coroutine.
+void finish_stack_usage_sampling(stack::stack_usage_histogram* histogram, stack::stack_t stack);
+
+} // namespace concore2full::detail
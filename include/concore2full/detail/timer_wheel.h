@@ -0,0 +1,167 @@
+#pragma once
+
+#include "concore2full/c/task.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <limits>
+
+namespace concore2full::detail {
+
+/**
+ * @brief Hierarchical timer wheel holding tasks that need to be executed at a given tick.
+ *
+ * The wheel has `num_levels` levels of `slots_per_level` slots each. A slot on level `l` covers
+ * `slots_per_level^l` ticks; a task is placed on the lowest level on which its deadline doesn't
+ * fall in the same slot as the current tick. When the wheel advances to a slot on a higher
+ * level, the tasks of that slot are moved to the lower levels. Inserting a task is O(1), and
+ * advancing the wheel is proportional to the number of non-empty slots visited, not to the number
+ * of ticks that passed.
+ *
+ * Deadlines that are too far away to fit in the wheel are placed on the last slot that fits, and
+ * moved again when that slot is reached.
+ *
+ * The tasks are linked through their `next_` fields. While a task is in the wheel, its
+ * `prev_link_` holds its deadline, and its `worker_data_` is null (i.e., the task is not
+ * extractable).
+ *
+ * This class is not thread-safe.
+ */
+class timer_wheel {
+public:
+  //! The number of levels of the wheel.
+  static constexpr int num_levels = 6;
+  //! The number of slots on each level.
+  static constexpr int slots_per_level = 64;
+  //! The value returned by `next_expiration()` if there are no tasks in the wheel.
+  static constexpr uint64_t no_expiration = std::numeric_limits<uint64_t>::max();
+
+  /**
+   * @brief Adds `task` to the wheel, to expire at tick `deadline`.
+   * @return `false` if the deadline has already passed; in this case, the task is not added.
+   */
+  bool insert(concore2full_task* task, uint64_t deadline) noexcept {
+    if (deadline <= elapsed_)
+      return false;
+    set_deadline(task, deadline);
+    task->worker_data_ = nullptr;
+    place(task, std::min(deadline, elapsed_ + max_distance));
+    size_++;
+    return true;
+  }
+
+  /**
+   * @brief Advances the wheel to tick `now`, removing all the tasks with deadlines up to `now`.
+   * @return The removed tasks, linked through their `next_` fields; null if no task expired.
+   *
+   * The order of the returned tasks is not specified.
+   */
+  [[nodiscard]] concore2full_task* advance(uint64_t now) noexcept {
+    concore2full_task* expired = nullptr;
+    int level = 0;
+    int slot = 0;
+    uint64_t slot_start = next_expiration(&level, &slot);
+    while (slot_start <= now) {
+      // Take all the tasks from the slot; they expire, or they move to lower levels.
+      concore2full_task* cur = slots_[level][slot];
+      slots_[level][slot] = nullptr;
+      occupied_[level] &= ~(uint64_t(1) << slot);
+      elapsed_ = slot_start;
+      while (cur) {
+        concore2full_task* next = cur->next_;
+        uint64_t deadline = deadline_of(cur);
+        if (deadline <= elapsed_) {
+          cur->next_ = expired;
+          cur->prev_link_ = nullptr;
+          expired = cur;
+          size_--;
+        } else {
+          place(cur, std::min(deadline, elapsed_ + max_distance));
+        }
+        cur = next;
+      }
+      slot_start = next_expiration(&level, &slot);
+    }
+    elapsed_ = std::max(elapsed_, now);
+    return expired;
+  }
+
+  //! Returns the tick at which the wheel needs to be advanced next, or `no_expiration` if the
+  //! wheel is empty. This is not later than the earliest deadline in the wheel.
+  uint64_t next_expiration() const noexcept {
+    int level = 0;
+    int slot = 0;
+    return next_expiration(&level, &slot);
+  }
+
+  //! Returns the tick the wheel was last advanced to.
+  uint64_t current_tick() const noexcept { return elapsed_; }
+
+  //! Returns the number of tasks in the wheel.
+  int size() const noexcept { return size_; }
+
+  //! Returns `true` if there are no tasks in the wheel.
+  bool empty() const noexcept { return size_ == 0; }
+
+private:
+  static_assert(std::has_single_bit(static_cast<unsigned>(slots_per_level)));
+  static_assert(sizeof(uintptr_t) >= sizeof(uint64_t), "deadlines are stored in pointers");
+
+  //! The number of bits needed to index a slot on a level.
+  static constexpr int bits_per_level = std::countr_zero(static_cast<unsigned>(slots_per_level));
+  //! The maximum distance between the current tick and the position of a task.
+  static constexpr uint64_t max_distance = (uint64_t(1) << (bits_per_level * num_levels)) - 1;
+
+  //! The tick to which the wheel was advanced.
+  uint64_t elapsed_{0};
+  //! The number of tasks in the wheel.
+  int size_{0};
+  //! For each level, the bitmap of the slots that hold tasks.
+  uint64_t occupied_[num_levels]{};
+  //! The lists of tasks in each slot.
+  concore2full_task* slots_[num_levels][slots_per_level]{};
+
+  static uint64_t deadline_of(concore2full_task* task) noexcept {
+    return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(task->prev_link_));
+  }
+  static void set_deadline(concore2full_task* task, uint64_t deadline) noexcept {
+    task->prev_link_ = reinterpret_cast<concore2full_task**>(static_cast<uintptr_t>(deadline));
+  }
+
+  //! Adds `task` to the slot corresponding to tick `position`; `position > elapsed_`.
+  void place(concore2full_task* task, uint64_t position) noexcept {
+    // The level is given by the most significant bits that differ from the current tick.
+    int significant_bit = 63 - std::countl_zero(position ^ elapsed_);
+    int level = std::min(significant_bit / bits_per_level, num_levels - 1);
+    int slot = static_cast<int>(position >> (level * bits_per_level)) & (slots_per_level - 1);
+    task->next_ = slots_[level][slot];
+    slots_[level][slot] = task;
+    occupied_[level] |= uint64_t(1) << slot;
+  }
+
+  //! Returns the first tick of the earliest non-empty slot, setting `level` and `slot` to its
+  //! position; returns `no_expiration` if the wheel is empty.
+  uint64_t next_expiration(int* level, int* slot) const noexcept {
+    // Lower levels hold earlier deadlines; the first non-empty level has the earliest one.
+    for (int l = 0; l < num_levels; l++) {
+      if (occupied_[l] == 0)
+        continue;
+      int shift = l * bits_per_level;
+      int current_slot = static_cast<int>(elapsed_ >> shift) & (slots_per_level - 1);
+      int distance = std::countr_zero(std::rotr(occupied_[l], current_slot));
+      int s = (current_slot + distance) & (slots_per_level - 1);
+      uint64_t level_range = uint64_t(1) << (shift + bits_per_level);
+      uint64_t start = (elapsed_ & ~(level_range - 1)) + (uint64_t(s) << shift);
+      // Only on the last level can slots wrap around to the next rotation.
+      if (start <= elapsed_)
+        start += level_range;
+      *level = l;
+      *slot = s;
+      return start;
+    }
+    return no_expiration;
+  }
+};
+
+} // namespace concore2full::detail
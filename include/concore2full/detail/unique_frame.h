@@ -13,7 +13,7 @@ template <typename Frame> struct unique_frame {
 
   explicit unique_frame(raw_unique_ptr<Frame>&& frame) : frame_(std::move(frame)) {}
 
-  void spawn() { frame_->spawn(); }
+  template <typename... Ts> void spawn(Ts&&... args) { frame_->spawn(std::forward<Ts>(args)...); }
 
   result_t await() { return frame_->await(); }
 
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "concore2full/c/task.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+
+namespace concore2full::detail {
+
+/**
+ * @brief Lock-free work-stealing deque of tasks (Chase-Lev).
+ *
+ * The owner thread pushes and pops tasks at the bottom of the deque (LIFO), while other threads
+ * steal tasks from the top (FIFO). None of the operations take locks.
+ *
+ * The deque has a fixed capacity; if the deque is full, `try_push` fails, and the caller needs to
+ * place the task somewhere else.
+ *
+ * Tasks can also be extracted from the middle of the deque (see `extract`). To support this, each
+ * slot of the deque is an atomic pointer, and whoever takes a task from the deque (owner, thief,
+ * or extractor) needs to claim it by resetting the slot to null. Slots that were claimed by an
+ * extractor remain in the deque as tombstones until the owner or the thieves skip over them.
+ *
+ * While a task is in the deque, its `prev_link_` points to the slot that holds it, and
+ * `worker_data_` points to the deque (with the lowest bit set, see `is_deque_data`).
+ */
+class work_stealing_deque {
+public:
+  //! Constructor. `capacity` must be a power of two.
+  explicit work_stealing_deque(uint32_t capacity = 1024)
+      : mask_(capacity - 1), slots_(std::make_unique<slot_t[]>(capacity)) {
+    assert(capacity > 0 && (capacity & mask_) == 0);
+  }
+
+  work_stealing_deque(const work_stealing_deque&) = delete;
+  work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+
+  //! Pushes `task` at the bottom of the deque. Returns `false` if the deque is full.
+  //! Must be called only by the owner thread.
+  bool try_push(concore2full_task* task) noexcept {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    if (b - t > static_cast<int64_t>(mask_))
+      return false;
+    slot_t& slot = slots_[b & mask_];
+    task->prev_link_ = reinterpret_cast<concore2full_task**>(&slot);
+    task->worker_data_ = to_worker_data(this);
+    slot.store(task, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  //! Pops a task from the bottom of the deque. Returns null if the deque is empty.
+  //! Must be called only by the owner thread.
+  [[nodiscard]] concore2full_task* pop() noexcept {
+    while (true) {
+      int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+      bottom_.store(b, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t t = top_.load(std::memory_order_relaxed);
+      if (t > b) {
+        // Empty deque.
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+      }
+      // Claim the task in the slot; it may be already claimed by a thief or an extractor.
+      concore2full_task* task = slots_[b & mask_].exchange(nullptr, std::memory_order_acq_rel);
+      if (t == b) {
+        // This was the last element; make sure thieves don't try to take it.
+        (void)top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                           std::memory_order_relaxed);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+      }
+      if (task)
+        return task;
+      // Skip over tombstones.
+    }
+  }
+
+  //! Steals a task from the top of the deque. Returns null if the deque is empty, or if there is
+  //! contention with other threads.
+  //! Can be called from any thread.
+  [[nodiscard]] concore2full_task* steal() noexcept {
+    while (true) {
+      int64_t t = top_.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t b = bottom_.load(std::memory_order_acquire);
+      if (t >= b)
+        return nullptr;
+      slot_t& slot = slots_[t & mask_];
+      concore2full_task* task = slot.load(std::memory_order_acquire);
+      // Claim the task first; once claimed, it's ours, even if we fail to advance `top_`.
+      bool claimed = task && slot.compare_exchange_strong(task, nullptr, std::memory_order_acq_rel,
+                                                          std::memory_order_relaxed);
+      bool advanced = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                   std::memory_order_relaxed);
+      if (claimed)
+        return task;
+      if (!advanced)
+        return nullptr; // contention
+      // We skipped over a tombstone; try again.
+    }
+  }
+
+  //! Returns `true` if the deque seems to be empty.
+  bool empty() const noexcept {
+    return top_.load(std::memory_order_relaxed) >= bottom_.load(std::memory_order_relaxed);
+  }
+
+  //! Extracts `task` from the deque that holds it, if it wasn't already taken.
+  //! `task->worker_data_` must indicate a deque (see `is_deque_data`).
+  //! Can be called from any thread.
+  static bool extract(concore2full_task* task) noexcept {
+    assert(is_deque_data(task->worker_data_));
+    auto* slot = reinterpret_cast<slot_t*>(task->prev_link_);
+    concore2full_task* expected = task;
+    return slot->compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel,
+                                         std::memory_order_relaxed);
+  }
+
+  //! Returns `true` if `worker_data` (the `worker_data_` field of a task) indicates a deque.
+  static bool is_deque_data(void* worker_data) noexcept {
+    return (reinterpret_cast<uintptr_t>(worker_data) & 1) != 0;
+  }
+
+private:
+  using slot_t = std::atomic<concore2full_task*>;
+  static_assert(sizeof(slot_t) == sizeof(concore2full_task*));
+
+  //! The index of the top of the deque; thieves steal from here.
+  alignas(64) std::atomic<int64_t> top_{0};
+  //! The index after the bottom of the deque; the owner pushes and pops here.
+  alignas(64) std::atomic<int64_t> bottom_{0};
+  //! Mask used to transform indices into slot positions.
+  alignas(64) const uint32_t mask_;
+  //! The slots holding the tasks.
+  std::unique_ptr<slot_t[]> slots_;
+
+  //! The value stored in `worker_data_` for the tasks in `deque`.
+  static void* to_worker_data(work_stealing_deque* deque) noexcept {
+    return reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(deque) | 1);
+  }
+};
+
+} // namespace concore2full::detail
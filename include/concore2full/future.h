@@ -1,7 +1,9 @@
 #pragma once
 
 #include "concore2full/c/spawn.h"
+#include "concore2full/stack/any_stack_allocator.h"
 
+#include <memory>
 #include <utility>
 
 namespace concore2full {
@@ -9,6 +11,8 @@ namespace concore2full {
 namespace detail {
 //! Tag type to indicate that a spawn operation is starting.
 struct start_spawn_t {};
+//! Tag type to indicate that a spawn operation is starting, with a hint for the thread pool.
+struct start_spawn_with_hint_t {};
 } // namespace detail
 
 //! An asynchronous computation created from a `spawn`-like call.
@@ -24,6 +28,21 @@ public:
     frame_.spawn();
   }
 
+  //! Construct the future and spawns the required computation, passing `hint` (e.g., a priority,
+  //! or the thread pool to enqueue the work to) when enqueueing the work.
+  template <typename H, typename... Ts>
+  future(detail::start_spawn_with_hint_t, H&& hint, Ts&&... ts) : frame_(std::forward<Ts>(ts)...) {
+    frame_.spawn(stack::any_stack_allocator{}, std::forward<H>(hint));
+  }
+
+  //! Construct the future and spawns the required computation, using `salloc` to allocate the
+  //! coroutine stacks.
+  template <typename S, typename... Ts>
+  future(detail::start_spawn_t, std::allocator_arg_t, S&& salloc, Ts&&... ts)
+      : frame_(std::forward<Ts>(ts)...) {
+    frame_.spawn(std::forward<S>(salloc));
+  }
+
   //! The type of the value that can be awaited on..
   using result_t = typename FrameHolder::result_t;
 
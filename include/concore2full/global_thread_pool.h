@@ -3,9 +3,26 @@
 #include "concore2full/thread_pool.h"
 #include "concore2full/thread_snapshot.h"
 
+#include <mutex>
+
 namespace concore2full {
 
 namespace detail {
+//! The state needed to configure the global thread pool before creating it.
+struct global_thread_pool_setup {
+  //! Protects the fields below; configuring and creating the pool can race.
+  std::mutex bottleneck_;
+  //! The configuration used for creating the global thread pool.
+  thread_pool::config config_;
+  //! Set to `true` when the global thread pool is created.
+  bool created_{false};
+};
+//! Returns the state needed to configure the global thread pool.
+inline global_thread_pool_setup& global_thread_pool_setup_data() {
+  static global_thread_pool_setup instance;
+  return instance;
+}
+
 /// Wrapper around the global thread pool, to be used in the `spawn()` function.
 /// Ensures that shutdown of the global thread pool is done on the same OS thread that started it.
 struct global_thread_pool_wrapper {
@@ -13,7 +30,18 @@ struct global_thread_pool_wrapper {
   thread_snapshot snapshot_;
 
   /// Constructs the wrapped thread pool, remembering the OS thread.
-  global_thread_pool_wrapper() { profiling::zone zone{CURRENT_LOCATION()}; }
+  global_thread_pool_wrapper() : wrapped_(creation_config()) {
+    profiling::zone zone{CURRENT_LOCATION()};
+  }
+
+  /// Marks the global thread pool as created, and returns the configuration to create it with.
+  static thread_pool::config creation_config() {
+    auto& setup = global_thread_pool_setup_data();
+    std::lock_guard lock{setup.bottleneck_};
+    setup.created_ = true;
+    return setup.config_;
+  }
+
   /// Reverts the thread snapshot and stops the wrapped thread pool.
   ~global_thread_pool_wrapper() {
     profiling::zone zone{CURRENT_LOCATION()};
@@ -23,6 +51,23 @@ struct global_thread_pool_wrapper {
 };
 } // namespace detail
 
+/**
+ * @brief Sets the configuration used to create the global thread pool.
+ * @param cfg The configuration of the global thread pool.
+ * @return `false` if the global thread pool was already created, and the configuration is ignored.
+ *
+ * This needs to be called before the first use of the global thread pool (i.e., before the first
+ * `spawn`), typically at the start of `main()`.
+ */
+inline bool configure_global_thread_pool(const thread_pool::config& cfg) {
+  auto& setup = detail::global_thread_pool_setup_data();
+  std::lock_guard lock{setup.bottleneck_};
+  if (setup.created_)
+    return false;
+  setup.config_ = cfg;
+  return true;
+}
+
 inline thread_pool& global_thread_pool() {
   static detail::global_thread_pool_wrapper instance;
   return instance.wrapped_;
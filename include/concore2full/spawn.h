@@ -4,10 +4,13 @@
 #include "concore2full/detail/bulk_spawn_frame_full.h"
 #include "concore2full/detail/copyable_spawn_frame_base.h"
 #include "concore2full/detail/frame_with_value.h"
+#include "concore2full/detail/lazy_spawn_frame_base.h"
 #include "concore2full/detail/shared_frame.h"
 #include "concore2full/detail/spawn_frame_base.h"
 #include "concore2full/detail/unique_frame.h"
 #include "concore2full/future.h"
+#include "concore2full/stack/any_stack_allocator.h"
+#include "concore2full/thread_pool.h"
 
 #include <concepts>
 #include <utility>
@@ -29,6 +32,122 @@ template <std::invocable Fn> inline auto spawn(Fn&& f) {
   return future<frame_holder_t>{detail::start_spawn_t{}, std::forward<Fn>(f)};
 }
 
+/**
+ * @brief Spawn work with the default scheduler, using the given stack allocator.
+ * @tparam S The type of the stack allocator.
+ * @tparam Fn The type of the function to execute.
+ * @param salloc The allocator used to allocate the stacks of the coroutines needed for the spawn.
+ * @param f The function representing the work that needs to be executed asynchronously.
+ * @return A `spawn_future` object; this object cannot be copied or moved
+ *
+ * Same as `spawn(f)`, but allows using smaller stacks for work that doesn't need much stack space.
+ * The allocator needs to be convertible to `stack::any_stack_allocator`.
+ *
+ * The stacks may be deallocated shortly after `await()` returns; any state referred by the
+ * allocator (e.g., a `stack::stack_pool`) needs to outlive the coroutines.
+ */
+template <stack::stack_allocator S, std::invocable Fn>
+inline auto spawn(std::allocator_arg_t, S&& salloc, Fn&& f) {
+  using frame_holder_t = detail::frame_with_value<detail::spawn_frame_base, Fn>;
+  return future<frame_holder_t>{detail::start_spawn_t{}, std::allocator_arg,
+                                stack::any_stack_allocator{std::forward<S>(salloc)},
+                                std::forward<Fn>(f)};
+}
+
+/**
+ * @brief Spawn work with the default scheduler, with the given priority.
+ * @tparam Fn The type of the function to execute.
+ * @param priority The priority with which the work is enqueued in the thread pool.
+ * @param f The function representing the work that needs to be executed asynchronously.
+ * @return A `spawn_future` object; this object cannot be copied or moved
+ *
+ * Same as `spawn(f)`, but the thread pool starts work with higher priority before work with lower
+ * priority.
+ */
+template <std::invocable Fn> inline auto spawn(task_priority priority, Fn&& f) {
+  using frame_holder_t = detail::frame_with_value<detail::spawn_frame_base, Fn>;
+  return future<frame_holder_t>{detail::start_spawn_with_hint_t{}, priority, std::forward<Fn>(f)};
+}
+
+/**
+ * @brief Spawn work with the default scheduler, preferably on the given worker thread.
+ * @tparam Fn The type of the function to execute.
+ * @param affinity Indicates the worker thread that should preferably execute the work.
+ * @param f The function representing the work that needs to be executed asynchronously.
+ * @return A `spawn_future` object; this object cannot be copied or moved
+ *
+ * Same as `spawn(f)`, but the work is placed on the work line of the given worker, to keep the data
+ * used by the work hot in the cache of that worker. Other threads can still steal the work.
+ */
+template <std::invocable Fn> inline auto spawn(worker_affinity affinity, Fn&& f) {
+  using frame_holder_t = detail::frame_with_value<detail::spawn_frame_base, Fn>;
+  return future<frame_holder_t>{detail::start_spawn_with_hint_t{}, affinity, std::forward<Fn>(f)};
+}
+
+/**
+ * @brief Spawn work on the given thread pool.
+ * @tparam Fn The type of the function to execute.
+ * @param pool The thread pool that executes the work.
+ * @param f The function representing the work that needs to be executed asynchronously.
+ * @return A `spawn_future` object; this object cannot be copied or moved
+ *
+ * Same as `spawn(f)`, but the work is executed by `pool` instead of the global thread pool. This
+ * allows isolating different kinds of work (e.g., CPU-heavy work and I/O completions) on separate
+ * thread pools. `pool` needs to outlive the returned object.
+ */
+template <std::invocable Fn> inline auto spawn(thread_pool& pool, Fn&& f) {
+  using frame_holder_t = detail::frame_with_value<detail::spawn_frame_base, Fn>;
+  return future<frame_holder_t>{detail::start_spawn_with_hint_t{}, pool, std::forward<Fn>(f)};
+}
+
+//! Tag type used to request a spawn that respects the capacity of the thread pool.
+struct bounded_t {};
+//! Tag value used to request a spawn that respects the capacity of the thread pool.
+inline constexpr bounded_t bounded{};
+
+/**
+ * @brief Spawn work on the given thread pool, respecting the capacity of the pool.
+ * @tparam Fn The type of the function to execute.
+ * @param pool The thread pool that executes the work.
+ * @param f The function representing the work that needs to be executed asynchronously.
+ * @return A `spawn_future` object; this object cannot be copied or moved
+ *
+ * Same as `spawn(pool, f)`, but if `pool` is full (see `thread_pool::config::max_pending_tasks`),
+ * the overflow policy of the pool is applied: with `overflow_policy::reject`, the work is not
+ * enqueued, and `await()` executes it; with `overflow_policy::caller_runs`, the work is executed
+ * before this returns; with `overflow_policy::suspend_producer`, this waits until the pool has
+ * room for the work.
+ */
+template <std::invocable Fn> inline auto spawn(bounded_t, thread_pool& pool, Fn&& f) {
+  using frame_holder_t = detail::frame_with_value<detail::spawn_frame_base, Fn>;
+  return future<frame_holder_t>{detail::start_spawn_with_hint_t{}, detail::bounded_pool_hint{&pool},
+                                std::forward<Fn>(f)};
+}
+
+//! Tag type used to request a spawn that doesn't allocate a coroutine stack upfront.
+struct lazy_stack_t {};
+//! Tag value used to request a spawn that doesn't allocate a coroutine stack upfront.
+inline constexpr lazy_stack_t lazy_stack{};
+
+/**
+ * @brief Spawn work with the default scheduler, running it on the stack of the worker thread.
+ * @tparam Fn The type of the function to execute.
+ * @param f The function representing the work that needs to be executed asynchronously.
+ * @return A `spawn_future` object; this object cannot be copied or moved
+ *
+ * Same as `spawn(f)`, but no coroutine stack is allocated for the spawned work; the work runs
+ * directly on the stack of the thread that picks it up. If the work is done by the time `await()`
+ * is called, no stack switch happens at all. If `await()` is called while the work is still
+ * running, the awaiting thread suspends, helping the thread pool, until the work is done; in this
+ * case, there is no thread inversion.
+ *
+ * This is a good fit for small tasks that typically finish before being awaited.
+ */
+template <std::invocable Fn> inline auto spawn(lazy_stack_t, Fn&& f) {
+  using frame_holder_t = detail::frame_with_value<detail::lazy_spawn_frame_base, Fn>;
+  return future<frame_holder_t>{detail::start_spawn_t{}, std::forward<Fn>(f)};
+}
+
 //! Same as `spawn`, but the returned future can be copied and moved.
 //! The caller is responsible for calling `await` exactly once on the returned object.
 template <std::invocable Fn> inline auto escaping_spawn(Fn&& f) {
@@ -37,6 +156,16 @@ template <std::invocable Fn> inline auto escaping_spawn(Fn&& f) {
   return future<frame_holder_t>{detail::start_spawn_t{}, std::forward<Fn>(f)};
 }
 
+//! Same as `escaping_spawn(f)`, but uses `salloc` to allocate the coroutine stacks.
+template <stack::stack_allocator S, std::invocable Fn>
+inline auto escaping_spawn(std::allocator_arg_t, S&& salloc, Fn&& f) {
+  using frame_holder_t =
+      detail::shared_frame<detail::frame_with_value<detail::spawn_frame_base, Fn>>;
+  return future<frame_holder_t>{detail::start_spawn_t{}, std::allocator_arg,
+                                stack::any_stack_allocator{std::forward<S>(salloc)},
+                                std::forward<Fn>(f)};
+}
+
 //! Same as `spawn`, but the returned future can be copied and moved.
 //! The caller is responsible for calling `await` exactly once on each copy of the returned object.
 template <std::invocable Fn> inline auto copyable_spawn(Fn&& f) {
@@ -45,6 +174,16 @@ template <std::invocable Fn> inline auto copyable_spawn(Fn&& f) {
   return future<frame_holder_t>{detail::start_spawn_t{}, std::forward<Fn>(f)};
 }
 
+//! Same as `copyable_spawn(f)`, but uses `salloc` to allocate the coroutine stacks.
+template <stack::stack_allocator S, std::invocable Fn>
+inline auto copyable_spawn(std::allocator_arg_t, S&& salloc, Fn&& f) {
+  using frame_holder_t =
+      detail::shared_frame<detail::frame_with_value<detail::copyable_spawn_frame_base, Fn>>;
+  return future<frame_holder_t>{detail::start_spawn_t{}, std::allocator_arg,
+                                stack::any_stack_allocator{std::forward<S>(salloc)},
+                                std::forward<Fn>(f)};
+}
+
 /**
  * @brief Bulk spawn work with the default scheduler.
  * @tparam Fn The type of the function to execute.
@@ -63,4 +202,51 @@ template <typename Fn> inline auto bulk_spawn(int count, Fn&& f) {
   return future<frame_holder_t>{detail::start_spawn_t{}, std::move(uptr)};
 }
 
+/**
+ * @brief Bulk spawn work with the default scheduler, spreading it over the worker threads.
+ * @tparam Fn The type of the function to execute.
+ * @param count The number of workers to spawn for handling the bulk work.
+ * @param f The function representing the work that needs to be executed asynchronously.
+ * @return A `bulk_spawn_future` object; this object cannot be copied or moved
+ *
+ * Same as `bulk_spawn(count, f)`, but the work item `i` is preferably executed by worker `i % N`,
+ * where `N` is the number of worker threads. Other threads can still steal the work.
+ */
+template <typename Fn> inline auto bulk_spawn(round_robin_workers_t, int count, Fn&& f) {
+  assert(count > 0);
+  using frame_holder_t = detail::unique_frame<detail::bulk_spawn_frame_full<Fn>>;
+  auto uptr = detail::bulk_spawn_frame_full<Fn>::allocate(count, std::forward<Fn>(f));
+  return future<frame_holder_t>{detail::start_spawn_with_hint_t{}, round_robin_workers,
+                                std::move(uptr)};
+}
+
+/**
+ * @brief Bulk spawn work on the given thread pool.
+ * @tparam Fn The type of the function to execute.
+ * @param pool The thread pool that executes the work.
+ * @param count The number of workers to spawn for handling the bulk work.
+ * @param f The function representing the work that needs to be executed asynchronously.
+ * @return A `bulk_spawn_future` object; this object cannot be copied or moved
+ *
+ * Same as `bulk_spawn(count, f)`, but the work is executed by `pool` instead of the global thread
+ * pool. `pool` needs to outlive the returned object.
+ */
+template <typename Fn> inline auto bulk_spawn(thread_pool& pool, int count, Fn&& f) {
+  assert(count > 0);
+  using frame_holder_t = detail::unique_frame<detail::bulk_spawn_frame_full<Fn>>;
+  auto uptr = detail::bulk_spawn_frame_full<Fn>::allocate(count, std::forward<Fn>(f));
+  return future<frame_holder_t>{detail::start_spawn_with_hint_t{}, pool, std::move(uptr)};
+}
+
+//! Same as `bulk_spawn(count, f)`, but uses `salloc` to allocate the coroutine stacks.
+template <stack::stack_allocator S, typename Fn>
+inline auto bulk_spawn(std::allocator_arg_t, S&& salloc, int count, Fn&& f) {
+  assert(count > 0);
+  using frame_holder_t = detail::unique_frame<detail::bulk_spawn_frame_full<Fn>>;
+  auto uptr = detail::bulk_spawn_frame_full<Fn>::allocate(count, std::forward<Fn>(f));
+  return future<frame_holder_t>{detail::start_spawn_t{}, std::allocator_arg,
+                                stack::any_stack_allocator{std::forward<S>(salloc)},
+                                std::move(uptr)};
+}
+
 } // namespace concore2full
\ No newline at end of file
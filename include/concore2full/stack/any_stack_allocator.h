@@ -0,0 +1,82 @@
+#pragma once
+
+#include "concore2full/c/stack_allocator.h"
+#include "concore2full/stack/pooled_stack_allocator.h"
+#include "concore2full/stack/stack_allocator.h"
+
+#include <concepts>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+namespace concore2full {
+namespace stack {
+
+/// @brief A type-erased stack allocator.
+///
+/// This can hold any stack allocator that is trivially copyable and has the size of at most a
+/// pointer (e.g., `simple_stack_allocator`, `mmap_stack_allocator` or `pooled_stack_allocator`).
+/// It is used to pass stack allocators through the type-erased spawn frames and through the C API.
+///
+/// A default-constructed object will use a `pooled_stack_allocator` with the default stack pool.
+class any_stack_allocator {
+public:
+  //! Constructor. Uses a `pooled_stack_allocator` with the default stack pool.
+  any_stack_allocator() : any_stack_allocator(pooled_stack_allocator{}) {}
+
+  //! Constructor. Uses the given C stack allocator.
+  explicit any_stack_allocator(const concore2full_stack_allocator& impl) : impl_(impl) {}
+
+  //! Constructor. Wraps the given stack allocator.
+  template <stack_allocator S>
+    requires(!std::same_as<std::remove_cvref_t<S>, any_stack_allocator>)
+  any_stack_allocator(S&& salloc) {
+    using T = std::remove_cvref_t<S>;
+    static_assert(std::is_trivially_copyable_v<T> && sizeof(T) <= sizeof(void*),
+                  "stack allocator is too big to be type-erased; store it by pointer");
+    impl_.allocate_fn_ = &allocate_impl<T>;
+    impl_.deallocate_fn_ = &deallocate_impl<T>;
+    impl_.data_ = nullptr;
+    std::memcpy(&impl_.data_, &salloc, sizeof(T));
+  }
+
+  /// @brief Allocate a stack to be used for coroutines.
+  /// @return Details about the newly allocated stack memory.
+  stack_t allocate() {
+    concore2full_stack stack = impl_.allocate_fn_(&impl_);
+    return {static_cast<std::size_t>(stack.size_), stack.sp_};
+  }
+  /// @brief Deallocate the stack memory.
+  /// @param stack Object indicating the stack that needs to be deallocated.
+  void deallocate(stack_t stack) { impl_.deallocate_fn_(&impl_, {stack.size, stack.sp}); }
+
+  //! Returns the C representation of this allocator.
+  const concore2full_stack_allocator& to_interface() const noexcept { return impl_; }
+
+private:
+  //! The C representation of the allocator.
+  concore2full_stack_allocator impl_;
+
+  //! Storage for a copy of an allocator of type `T`.
+  template <typename T> struct unpacked {
+    alignas(T) unsigned char storage_[sizeof(T)];
+
+    explicit unpacked(const concore2full_stack_allocator* self) {
+      std::memcpy(storage_, &self->data_, sizeof(T));
+    }
+    T* operator->() noexcept { return std::launder(reinterpret_cast<T*>(storage_)); }
+  };
+
+  template <typename T>
+  static concore2full_stack allocate_impl(concore2full_stack_allocator* self) {
+    stack_t stack = unpacked<T>{self}->allocate();
+    return {stack.size, stack.sp};
+  }
+  template <typename T>
+  static void deallocate_impl(concore2full_stack_allocator* self, concore2full_stack stack) {
+    unpacked<T>{self}->deallocate({static_cast<std::size_t>(stack.size_), stack.sp_});
+  }
+};
+
+} // namespace stack
+} // namespace concore2full
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "concore2full/stack/stack_allocator.h"
+
+#include <mutex>
+#include <vector>
+
+namespace concore2full {
+namespace stack {
+
+/// @brief A slab of coroutine stacks carved out of large regions backed by huge pages.
+///
+/// With many live coroutines, each touching a few pages of its own stack, switching between
+/// coroutines can cause a lot of TLB misses. This slab maps large regions of memory, backed by
+/// huge pages, and carves fixed-size stacks out of them; this way, many stacks share the same TLB
+/// entry.
+///
+/// For each new region, we first try explicit huge pages (`MAP_HUGETLB`); if the system doesn't
+/// have huge pages reserved, we fall back to normal pages, asking for transparent huge pages
+/// (`madvise(MADV_HUGEPAGE)`). If that is also not available, the region uses normal pages.
+/// Explicit huge page regions are rounded up to the default huge page size of the system (which
+/// can be 1 GiB); the other regions are sized and aligned to the transparent huge page size.
+///
+/// Freed stacks are kept in a free list, to be reused; the regions are released only when the
+/// slab is destroyed. The stacks don't have guard pages, as that would split the huge pages.
+///
+/// The slab must not be destroyed while there are stacks allocated from it that were not
+/// deallocated.
+class hugepage_stack_slab {
+public:
+  //! The configuration parameters of a huge-page stack slab.
+  struct config {
+    //! The size of the stacks allocated from the slab; rounded up to a multiple of page size.
+    std::size_t stack_size{64 * 1024};
+    //! The size of the regions mapped from the system; rounded up to a multiple of the
+    //! transparent huge page size, and to hold at least one stack.
+    std::size_t region_size{32 * 1024 * 1024};
+  };
+
+  //! Describes the type of memory pages used for a region.
+  enum class page_backing {
+    //! Explicit huge pages, obtained with `MAP_HUGETLB`.
+    explicit_huge_pages,
+    //! Transparent huge pages, requested with `madvise(MADV_HUGEPAGE)`.
+    transparent_huge_pages,
+    //! Normal memory pages.
+    normal_pages,
+  };
+
+  //! Constructor. Uses the default configuration.
+  hugepage_stack_slab();
+  //! Constructor. Uses the given configuration.
+  explicit hugepage_stack_slab(const config& cfg);
+  //! Destructor. Releases all the regions.
+  ~hugepage_stack_slab();
+
+  hugepage_stack_slab(const hugepage_stack_slab&) = delete;
+  hugepage_stack_slab& operator=(const hugepage_stack_slab&) = delete;
+
+  /// @brief Allocate a stack to be used for coroutines.
+  /// @return Details about the allocated stack memory.
+  stack_t allocate();
+  /// @brief Returns a stack to the slab.
+  /// @param stack Object indicating the stack that is not used anymore.
+  void deallocate(stack_t stack);
+
+  //! Returns the size of the stacks allocated from this slab.
+  std::size_t stack_size() const noexcept { return stack_size_; }
+  //! Returns the size of the regions mapped by this slab. Regions backed by explicit huge pages
+  //! are rounded up to `huge_page_size()`.
+  std::size_t region_size() const noexcept { return region_size_; }
+  //! Returns the number of regions mapped so far.
+  std::size_t region_count() const noexcept;
+  //! Returns the page backing of the last region that was mapped; `normal_pages` if no region was
+  //! mapped yet.
+  page_backing backing() const noexcept;
+
+  //! Returns the size of an explicit huge page: the default huge page size of the system, as
+  //! reported by `/proc/meminfo`, or 2 MiB if that is not available. `MAP_HUGETLB` regions are
+  //! sized to this.
+  static std::size_t huge_page_size() noexcept;
+  //! Returns the size of a transparent huge page, as reported by
+  //! `/sys/kernel/mm/transparent_hugepage/hpage_pmd_size`, or 2 MiB if that is not available.
+  //! The regions using normal or transparent huge pages are sized and aligned to this.
+  static std::size_t transparent_huge_page_size() noexcept;
+
+private:
+  struct free_node;
+
+  //! A region of memory mapped from the system.
+  struct mapped_region {
+    //! The start address of the region.
+    void* start_;
+    //! The size of the mapping.
+    std::size_t size_;
+  };
+
+  //! The size of the stacks allocated from this slab.
+  std::size_t stack_size_;
+  //! The size of the regions mapped by this slab.
+  std::size_t region_size_;
+  //! Mutex protecting the state of the slab.
+  mutable std::mutex bottleneck_;
+  //! The list of stacks that were freed.
+  free_node* free_list_{nullptr};
+  //! The start of the unused part of the current region.
+  char* region_cur_{nullptr};
+  //! The end of the current region.
+  char* region_end_{nullptr};
+  //! All the mapped regions.
+  std::vector<mapped_region> regions_;
+  //! The page backing of the last mapped region.
+  page_backing last_backing_{page_backing::normal_pages};
+
+  //! Maps a new region, and makes it the current one.
+  void map_region();
+};
+
+/// @brief A stack allocator that carves stacks out of a `hugepage_stack_slab`.
+///
+/// The allocator just refers to the slab; the slab needs to outlive all the stacks allocated
+/// through this allocator.
+class hugepage_stack_allocator {
+  hugepage_stack_slab* slab_;
+
+public:
+  //! Constructor. Uses the given slab.
+  explicit hugepage_stack_allocator(hugepage_stack_slab& slab) : slab_(&slab) {}
+
+  /// @brief Allocate a stack to be used for coroutines.
+  /// @return Details about the allocated stack memory.
+  stack_t allocate() { return slab_->allocate(); }
+  /// @brief Returns the stack memory to the slab.
+  /// @param stack Object indicating the stack that needs to be deallocated.
+  void deallocate(stack_t stack) { slab_->deallocate(stack); }
+};
+
+} // namespace stack
+} // namespace concore2full
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "concore2full/stack/stack_allocator.h"
+
+#include <new>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace concore2full {
+namespace stack {
+
+/// @brief A stack allocator that maps the stack memory directly from the OS.
+///
+/// Each time a new coroutine stack is needed, this will reserve a new region of virtual memory for
+/// it. The memory is not committed upfront: pages are backed by physical memory only when the
+/// coroutine touches them, so the cost of a coroutine is proportional to the depth of its stack,
+/// and not to the reserved size. No swap space is reserved for the stack (`MAP_NORESERVE`).
+///
+/// Below the stack we place a guard page (`PROT_NONE`); a stack overflow will fault on this page
+/// instead of silently corrupting other memory.
+///
+/// The allocator can receive a size on constructor to be used when allocating stacks; this will be
+/// rounded up to a multiple of the page size. If this size is not provided, a default stack size
+/// will be used.
+class mmap_stack_allocator {
+  std::size_t size_;
+
+public:
+  /// The default stack size
+  static constexpr std::size_t default_size_ = 1024 * 1024;
+
+  /// @brief Initializes the size to be used when allocating stacks.
+  /// @param size The size to be used for allocating stack. Default = 1MB
+  mmap_stack_allocator(std::size_t size = default_size_) : size_(size) {}
+
+  /// @brief Allocate a stack to be used for coroutines.
+  /// @return Details about the newly allocated stack memory.
+  stack_t allocate() {
+    std::size_t page = page_size();
+    std::size_t size = allocate_size();
+    std::size_t total = size + page;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+#ifdef MAP_STACK
+    flags |= MAP_STACK;
+#endif
+    void* mem = ::mmap(nullptr, total, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (mem == MAP_FAILED)
+      throw std::bad_alloc();
+    // Install the guard page at the bottom of the stack.
+    if (::mprotect(mem, page, PROT_NONE) != 0) {
+      ::munmap(mem, total);
+      throw std::bad_alloc();
+    }
+    return {size, static_cast<char*>(mem) + total};
+  }
+  /// @brief Deallocate the stack memory.
+  /// @param stack Object indicating the stack that needs to be deallocated.
+  void deallocate(stack_t stack) {
+    std::size_t page = page_size();
+    void* mem = static_cast<char*>(stack.sp) - stack.size - page;
+    ::munmap(mem, stack.size + page);
+  }
+
+  //! Returns the size of the stacks returned by `allocate()`; a multiple of the page size.
+  std::size_t allocate_size() const noexcept {
+    std::size_t page = page_size();
+    return (size_ + page - 1) / page * page;
+  }
+
+  //! Returns the size of a memory page.
+  static std::size_t page_size() noexcept {
+    static const std::size_t value = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    return value;
+  }
+};
+
+} // namespace stack
+} // namespace concore2full
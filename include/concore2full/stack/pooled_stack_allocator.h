@@ -0,0 +1,127 @@
+#pragma once
+
+#include "concore2full/stack/simple_stack_allocator.h"
+#include "concore2full/stack/stack_allocator.h"
+
+#include <mutex>
+
+namespace concore2full {
+namespace stack {
+
+/// @brief A pool of coroutine stacks of the same size, that can be reused.
+///
+/// Instead of allocating and freeing memory each time a coroutine is created and destroyed, this
+/// keeps the freed stacks around, so that they can be reused by the next coroutines.
+///
+/// Each thread has its own list of free stacks, so that allocation and deallocation are typically
+/// done without any synchronization. When a thread has more than `high_watermark` free stacks, it
+/// will move the excess stacks (keeping `low_watermark` stacks) to a global overflow list. When a
+/// thread runs out of free stacks, it will first try to take stacks from the global overflow list,
+/// before allocating new memory. The global overflow list is limited to `max_global_stacks`
+/// stacks; the excess stacks are released back to the system.
+///
+/// A stack may be deallocated on a different thread than the one that allocated it.
+///
+/// The pool must not be destroyed while there are stacks allocated from it that were not
+/// deallocated.
+class stack_pool {
+public:
+  //! The configuration parameters of a stack pool.
+  struct config {
+    //! The size of the stacks allocated by the pool.
+    std::size_t stack_size{simple_stack_allocator::default_size_};
+    //! The maximum number of free stacks kept by a thread before moving stacks to the global list.
+    std::size_t high_watermark{32};
+    //! The number of free stacks kept by a thread after moving stacks to the global list; this is
+    //! also the maximum number of stacks that a thread takes at once from the global list.
+    std::size_t low_watermark{8};
+    //! The maximum number of free stacks kept in the global overflow list.
+    std::size_t max_global_stacks{256};
+  };
+
+  //! Constructor. Uses the default configuration.
+  stack_pool();
+  //! Constructor. Uses the given configuration.
+  explicit stack_pool(const config& cfg);
+  //! Destructor. Releases all the free stacks.
+  ~stack_pool();
+
+  stack_pool(const stack_pool&) = delete;
+  stack_pool& operator=(const stack_pool&) = delete;
+
+  /// @brief Allocate a stack to be used for coroutines.
+  /// @return Details about the allocated stack memory.
+  stack_t allocate();
+  /// @brief Returns a stack to the pool.
+  /// @param stack Object indicating the stack that is not used anymore.
+  void deallocate(stack_t stack);
+
+  //! Returns the size of the stacks allocated by this pool.
+  std::size_t stack_size() const noexcept { return config_.stack_size; }
+
+  //! Returns the maximum number of free stacks that a thread keeps in its cache.
+  std::size_t high_watermark() const noexcept { return config_.high_watermark; }
+
+  //! Returns the number of free stacks kept in the global overflow list.
+  std::size_t global_free_count() const noexcept;
+
+private:
+  struct free_node;
+  struct thread_cache;
+  struct thread_caches;
+
+  //! The configuration of this pool.
+  config config_;
+  //! Mutex protecting the global overflow list.
+  mutable std::mutex bottleneck_;
+  //! The global overflow list of free stacks.
+  free_node* global_list_{nullptr};
+  //! The number of stacks in `global_list_`.
+  std::size_t global_count_{0};
+  //! The thread caches registered with this pool; protected by the global registry mutex.
+  thread_cache* caches_{nullptr};
+
+  //! Returns the caches of the current thread, for all the pools.
+  static thread_caches& current_thread_caches();
+  //! Returns the cache of the current thread for this pool.
+  thread_cache& local_cache();
+  //! Moves the stacks of `cache` down to `keep` stacks into the global list.
+  void spill(thread_cache& cache, std::size_t keep) noexcept;
+  //! Moves up to `low_watermark` stacks from the global list into `cache`.
+  void refill(thread_cache& cache) noexcept;
+  //! Removes `cache` from the list of caches registered with this pool.
+  void unregister(thread_cache* cache) noexcept;
+  //! Returns the node corresponding to a free stack.
+  static free_node* to_node(stack_t stack) noexcept;
+  //! Returns the stack corresponding to a free node.
+  stack_t to_stack(free_node* node) const noexcept;
+  //! Releases to the system all the stacks from the list starting at `head`.
+  void release_list(free_node* head) const noexcept;
+};
+
+//! Returns the stack pool used by default when spawning work.
+stack_pool& default_stack_pool();
+
+/// @brief A stack allocator that reuses stacks from a `stack_pool`.
+///
+/// This is the allocator used by default for spawning work. Stacks are taken from and returned to
+/// the given pool; if no pool is given, `default_stack_pool()` is used.
+class pooled_stack_allocator {
+  stack_pool* pool_;
+
+public:
+  //! Constructor. Uses the default stack pool.
+  pooled_stack_allocator() : pool_(&default_stack_pool()) {}
+  //! Constructor. Uses the given stack pool.
+  explicit pooled_stack_allocator(stack_pool& pool) : pool_(&pool) {}
+
+  /// @brief Allocate a stack to be used for coroutines.
+  /// @return Details about the allocated stack memory.
+  stack_t allocate() { return pool_->allocate(); }
+  /// @brief Returns the stack memory to the pool.
+  /// @param stack Object indicating the stack that needs to be deallocated.
+  void deallocate(stack_t stack) { pool_->deallocate(stack); }
+};
+
+} // namespace stack
+} // namespace concore2full
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "concore2full/stack/mmap_stack_allocator.h"
+#include "concore2full/stack/stack_allocator.h"
+
+#include <chrono>
+#include <mutex>
+
+namespace concore2full {
+namespace stack {
+
+/// @brief A cache of coroutine stacks that gives the memory of idle stacks back to the system.
+///
+/// Freed stacks are kept in the cache, so that the next coroutines can reuse them quickly. After a
+/// burst of coroutines, keeping all the stacks around would pin the memory usage to the peak; to
+/// avoid this, the dirty pages of the cached stacks are returned to the system (with
+/// `madvise(MADV_FREE)`, or `MADV_DONTNEED` if the former is not available) when:
+///  - the stack was not used for more than `idle_period`, or
+///  - the dirty cached stacks take more than `byte_budget` bytes.
+/// The stacks remain mapped, so reusing them is still cheap: the kernel provides fresh pages as
+/// they are touched.
+///
+/// The stacks that were used most recently are reused first, and the ones that are idle for the
+/// longest time are reclaimed first. At most `max_cached_stacks` are kept in the cache; the rest
+/// are unmapped.
+///
+/// The policy is applied each time a stack is allocated or deallocated; long-running services
+/// that may become idle can also call `reclaim()` periodically.
+///
+/// The stacks are obtained from `mmap_stack_allocator`, so they have guard pages. The cache must
+/// not be destroyed while there are stacks allocated from it that were not deallocated.
+class reclaiming_stack_cache {
+public:
+  //! The type of clock used to measure the idle period.
+  using clock = std::chrono::steady_clock;
+
+  //! The configuration parameters of a reclaiming stack cache.
+  struct config {
+    //! The size of the stacks allocated by the cache.
+    std::size_t stack_size{mmap_stack_allocator::default_size_};
+    //! The time after which the pages of an unused cached stack are given back to the system.
+    clock::duration idle_period{std::chrono::seconds(1)};
+    //! The maximum number of bytes of cached stacks that keep their pages.
+    std::size_t byte_budget{16 * 1024 * 1024};
+    //! The maximum number of stacks kept in the cache.
+    std::size_t max_cached_stacks{1024};
+  };
+
+  //! Constructor. Uses the default configuration.
+  reclaiming_stack_cache();
+  //! Constructor. Uses the given configuration.
+  explicit reclaiming_stack_cache(const config& cfg);
+  //! Destructor. Releases all the cached stacks.
+  ~reclaiming_stack_cache();
+
+  reclaiming_stack_cache(const reclaiming_stack_cache&) = delete;
+  reclaiming_stack_cache& operator=(const reclaiming_stack_cache&) = delete;
+
+  /// @brief Allocate a stack to be used for coroutines.
+  /// @return Details about the allocated stack memory.
+  stack_t allocate();
+  /// @brief Returns a stack to the cache.
+  /// @param stack Object indicating the stack that is not used anymore.
+  void deallocate(stack_t stack);
+
+  //! Gives back to the system the pages of the stacks that are idle for too long.
+  void reclaim();
+
+  //! Returns the size of the stacks allocated by this cache.
+  std::size_t stack_size() const noexcept { return upstream_size_; }
+  //! Returns the number of stacks kept in the cache.
+  std::size_t cached_count() const noexcept;
+  //! Returns the number of bytes of cached stacks whose pages were not yet given back.
+  std::size_t dirty_bytes() const noexcept;
+
+private:
+  struct free_node;
+
+  //! The configuration of this cache.
+  config config_;
+  //! The actual size of the stacks, after rounding up to the page size.
+  std::size_t upstream_size_;
+  //! Mutex protecting the state of the cache.
+  mutable std::mutex bottleneck_;
+  //! The most recently freed stack.
+  free_node* head_{nullptr};
+  //! The stack that is freed the longest time ago.
+  free_node* tail_{nullptr};
+  //! The oldest stack that still has its pages; all the stacks after it are clean.
+  free_node* oldest_dirty_{nullptr};
+  //! The number of stacks in the cache.
+  std::size_t count_{0};
+  //! The number of bytes of the dirty stacks.
+  std::size_t dirty_bytes_{0};
+
+  //! Applies the reclaim policy; must be called with the mutex held.
+  void reclaim_locked(clock::time_point now) noexcept;
+  //! Gives back to the system the pages of the stack corresponding to `node`.
+  void release_pages(free_node* node) noexcept;
+  //! Removes `node` from the list of cached stacks.
+  void unlink(free_node* node) noexcept;
+  //! Returns the node corresponding to a free stack.
+  static free_node* to_node(stack_t stack) noexcept;
+  //! Returns the stack corresponding to a free node.
+  stack_t to_stack(free_node* node) const noexcept;
+};
+
+/// @brief A stack allocator that reuses stacks from a `reclaiming_stack_cache`.
+///
+/// The allocator just refers to the cache; the cache needs to outlive all the stacks allocated
+/// through this allocator.
+class reclaiming_stack_allocator {
+  reclaiming_stack_cache* cache_;
+
+public:
+  //! Constructor. Uses the given cache.
+  explicit reclaiming_stack_allocator(reclaiming_stack_cache& cache) : cache_(&cache) {}
+
+  /// @brief Allocate a stack to be used for coroutines.
+  /// @return Details about the allocated stack memory.
+  stack_t allocate() { return cache_->allocate(); }
+  /// @brief Returns the stack memory to the cache.
+  /// @param stack Object indicating the stack that needs to be deallocated.
+  void deallocate(stack_t stack) { cache_->deallocate(stack); }
+};
+
+} // namespace stack
+} // namespace concore2full
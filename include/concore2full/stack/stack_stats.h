@@ -0,0 +1,35 @@
+#pragma once
+
+#include "concore2full/c/stack_stats.h"
+
+namespace concore2full {
+namespace stack {
+
+/// @brief Statistics about the coroutine stacks.
+///
+/// The live stacks are the stacks of the coroutines that are not yet destroyed, regardless of the
+/// allocator used. The cached stacks are the free stacks kept for reuse by the allocators that
+/// cache stacks (`pooled_stack_allocator`, `hugepage_stack_allocator` and
+/// `reclaiming_stack_allocator`). Summing live and cached bytes gives the memory reserved for
+/// coroutine stacks; the memory actually committed is typically much smaller, as stacks are
+/// touched only up to their high-water mark (see `stack_usage_histogram`).
+///
+/// The counters are kept per thread, so that threads creating coroutines don't contend on them.
+/// The peak values are sampled from the totals every few stack allocations and whenever the
+/// statistics are read, so very short spikes may be missed.
+///
+/// When profiling is enabled, the number of live stacks, and the live and cached bytes are also
+/// emitted as counter tracks.
+using stack_stats = concore2full_stack_stats;
+
+//! Returns the current statistics about the coroutine stacks.
+stack_stats get_stack_stats() noexcept;
+
+//! Returns the number of stack allocations per second between the two given statistics.
+double allocation_rate(const stack_stats& older, const stack_stats& newer) noexcept;
+
+//! Resets the peak values to the current values.
+void reset_peak_stack_stats() noexcept;
+
+} // namespace stack
+} // namespace concore2full
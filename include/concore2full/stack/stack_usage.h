@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace concore2full {
+namespace stack {
+
+/// @brief Histogram of the stack usage of coroutines.
+///
+/// Each sample is the maximum number of bytes that a coroutine used from its stack (the high-water
+/// mark). Samples are grouped in power-of-two buckets: bucket 0 counts the usages up to 1 KiB,
+/// bucket `i` counts the usages in range (2^(i+9), 2^(i+10)] bytes; the last bucket counts all the
+/// bigger usages.
+///
+/// All the operations are thread-safe.
+class stack_usage_histogram {
+public:
+  //! The number of buckets in the histogram.
+  static constexpr int num_buckets = 24;
+
+  //! Constructor. Creates a histogram for stacks of size `stack_size`.
+  explicit stack_usage_histogram(std::size_t stack_size);
+
+  stack_usage_histogram(const stack_usage_histogram&) = delete;
+  stack_usage_histogram& operator=(const stack_usage_histogram&) = delete;
+
+  //! Records a sample of `used` bytes of stack.
+  void record(std::size_t used) noexcept;
+
+  //! Removes all the recorded samples.
+  void reset() noexcept;
+
+  //! The size of the stacks for which this histogram records samples.
+  std::size_t stack_size() const noexcept { return stack_size_; }
+  //! The number of recorded samples.
+  uint64_t count() const noexcept { return count_.load(std::memory_order_relaxed); }
+  //! The maximum stack usage that was recorded.
+  std::size_t max_usage() const noexcept { return max_usage_.load(std::memory_order_relaxed); }
+  //! The number of samples in the bucket with the given index.
+  uint64_t bucket(int index) const noexcept {
+    return buckets_[index].load(std::memory_order_relaxed);
+  }
+  //! The maximum usage counted in the bucket with the given index.
+  static std::size_t bucket_upper_bound(int index) noexcept { return std::size_t(1024) << index; }
+
+  //! Returns the upper bound of the bucket containing the `p` percentile (0 < `p` <= 1) of the
+  //! recorded samples. Returns 0 if there are no samples.
+  std::size_t usage_percentile(double p) const noexcept;
+
+private:
+  //! The size of the stacks for which this histogram records samples.
+  std::size_t stack_size_;
+  //! The number of recorded samples.
+  std::atomic<uint64_t> count_{0};
+  //! The maximum stack usage that was recorded.
+  std::atomic<std::size_t> max_usage_{0};
+  //! The sample counts for each bucket.
+  std::atomic<uint64_t> buckets_[num_buckets]{};
+  //! The name of the counter track used for profiling.
+  char name_[48];
+};
+
+/// @brief Turns on or off the sampling of the stack usage for coroutines.
+///
+/// When sampling is turned on, the stacks of the newly created coroutines are filled with a canary
+/// pattern; when the coroutines are destroyed, we look at how much of the pattern was overwritten,
+/// and record the high-water mark in the histogram corresponding to the size of the stack.
+///
+/// Sampling has a significant cost: the entire stack needs to be written at creation, and scanned
+/// at destruction. This will also commit all the pages of lazily-committed stacks.
+void enable_stack_usage_sampling(bool enabled) noexcept;
+
+//! Returns `true` if the stack usage sampling is turned on.
+bool stack_usage_sampling_enabled() noexcept;
+
+//! Returns the histogram that records the stack usage for stacks of size `stack_size`.
+stack_usage_histogram& stack_usage_for(std::size_t stack_size);
+
+//! Returns all the stack usage histograms, one for each stack size seen while sampling.
+std::vector<const stack_usage_histogram*> stack_usage_histograms();
+
+/// @brief Sizing policy: returns the smallest safe stack size, based on the recorded samples.
+/// @param usage The histogram with the recorded stack usage.
+/// @param min_size The minimum stack size to be returned.
+/// @return The recommended size of the stack.
+///
+/// The returned size is a power of two that is at least twice the maximum recorded usage, but not
+/// bigger than the size of the stacks that were sampled. If there are no samples, this returns the
+/// size of the sampled stacks.
+std::size_t recommended_stack_size(const stack_usage_histogram& usage,
+                                   std::size_t min_size = 16 * 1024);
+
+} // namespace stack
+} // namespace concore2full
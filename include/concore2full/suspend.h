@@ -1,9 +1,12 @@
 #pragma once
 
+#include <chrono>
 #include <stop_token>
 
 namespace concore2full {
 
+class thread_pool;
+
 //! Token used for waking up a suspended execution.
 struct suspend_token {
   //! Wake up the execution that is suspended on this token.
@@ -16,8 +19,8 @@ private:
   //! Stop source that signals when the execution should be woken up.
   std::stop_source stop_source_;
 
-  friend void suspend(suspend_token& token);
-  friend void suspend_quick_resume(suspend_token& token);
+  friend void suspend(thread_pool& pool, suspend_token& token);
+  friend void suspend_quick_resume(thread_pool& pool, suspend_token& token);
 };
 
 //! Suspends the current execution until `token` is notified.
@@ -26,6 +29,10 @@ private:
 //! This will allow the thread pool to use the current thread for other activities.
 void suspend(suspend_token& token);
 
+//! Same as `suspend(token)`, but while suspended, the current thread helps `pool` instead of the
+//! global thread pool.
+void suspend(thread_pool& pool, suspend_token& token);
+
 //! Suspends the current execution until `token` is notified; when notified, the execution will
 //! continue asap.
 //!
@@ -34,4 +41,25 @@ void suspend(suspend_token& token);
 //! the current thread for other activities.
 void suspend_quick_resume(suspend_token& token);
 
+//! Same as `suspend_quick_resume(token)`, but helps `pool` while suspended, and resumes the
+//! execution with a task enqueued to `pool`.
+void suspend_quick_resume(thread_pool& pool, suspend_token& token);
+
+//! Suspends the current execution for (at least) the given amount of time.
+//!
+//! This doesn't block the current thread; while suspended, the thread helps the global thread
+//! pool, and the execution is woken up by a timer of the pool (see `thread_pool::enqueue_after()`).
+void sleep_for(std::chrono::steady_clock::duration duration);
+
+//! Same as `sleep_for(duration)`, but uses the timers of `pool`, and helps `pool` while suspended.
+void sleep_for(thread_pool& pool, std::chrono::steady_clock::duration duration);
+
+//! Suspends the current execution until the given point in time.
+//! @sa sleep_for()
+void sleep_until(std::chrono::steady_clock::time_point deadline);
+
+//! Same as `sleep_until(deadline)`, but uses the timers of `pool`, and helps `pool` while
+//! suspended.
+void sleep_until(thread_pool& pool, std::chrono::steady_clock::time_point deadline);
+
 } // namespace concore2full
\ No newline at end of file
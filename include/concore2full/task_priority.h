@@ -0,0 +1,13 @@
+#pragma once
+
+namespace concore2full {
+
+//! The priority of a task executed by a thread pool.
+//! Tasks with higher priority are executed before the tasks with lower priority.
+enum class task_priority {
+  low,
+  normal,
+  high,
+};
+
+} // namespace concore2full
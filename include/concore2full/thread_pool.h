@@ -1,31 +1,155 @@
 #pragma once
 
 #include "concore2full/c/task.h"
+#include "concore2full/c/thread_pool_stats.h"
 #include "concore2full/detail/catomic.h"
+#include "concore2full/detail/sharded_counter.h"
 #include "concore2full/detail/sleep_helper.h"
+#include "concore2full/detail/timer_wheel.h"
+#include "concore2full/detail/work_stealing_deque.h"
 #include "concore2full/profiling.h"
+#include "concore2full/task_priority.h"
 
 #include <cassert>
+#include <chrono>
+#include <latch>
+#include <limits>
+#include <memory>
 #include <mutex>
 #include <stop_token>
 #include <thread>
 #include <vector>
 
+//! Whether the thread pool keeps scheduling statistics; if 0, the counters compile to nothing.
+#ifndef CONCORE2FULL_SCHEDULER_STATS
+#define CONCORE2FULL_SCHEDULER_STATS 1
+#endif
+
 namespace concore2full {
 
+//! Statistics about the scheduling of tasks in a thread pool.
+using thread_pool_stats = concore2full_thread_pool_stats;
+
 /**
  * @brief A thread pool that can execute work.
  *
  * This will start a number of threads, each of them able to execute tasks. If not specified, the
  * number of threads will match the available concurrency on the target hardware; doing this will
  * try to ensure that we are properly utilize hardware resources to maximize throughput.
+ *
+ * Each worker thread has a lock-free work-stealing deque; the tasks enqueued from a worker thread
+ * are pushed into the worker's deque, and other threads can steal them. Besides the deques, there
+ * is a set of work lines (mutex-protected task lists). Threads that help the pool (see
+ * `offer_help_until()`) push their tasks to the line they are working on; so do worker threads if
+ * their deques are disabled or full. The tasks enqueued from threads outside the pool are
+ * distributed round-robin over the work lines.
+ *
+ * The number of active worker threads can be changed at runtime (see `set_parallelism()`), up to
+ * `config::max_threads`. Workers that are not active are parked; the tasks already enqueued are
+ * executed by the active workers.
+ *
+ * Tasks can be enqueued with a priority (see `task_priority`). High-priority and low-priority
+ * tasks are placed in their own sets of work lines. Threads execute higher-priority tasks first;
+ * to prevent starvation, every `config::starvation_limit`-th task that a thread picks is searched
+ * starting from the lowest priority.
+ *
+ * The pool can have a capacity (see `config::max_pending_tasks`). Producers that need backpressure
+ * use `try_enqueue()`, `enqueue_bounded()` or `spawn(bounded, pool, f)`, which respect the
+ * capacity; `enqueue()` always accepts the task, as it's also used to resume executions that are
+ * already in progress.
+ *
+ * Tasks can also be scheduled to be enqueued at a later time (see `enqueue_after()`). These tasks
+ * are kept in a timer wheel, serviced by the worker threads: busy threads check the timers between
+ * tasks, and one of the idle threads sleeps until the earliest timer expires.
  */
 class thread_pool {
 public:
+  //! The order in which tasks are taken from the work lines and from the deques.
+  enum class queue_order {
+    //! The newest task first; best for depth-first, recursive, work.
+    lifo,
+    //! The oldest task first; bounds the queueing delay of tasks, e.g., of requests in a server.
+    fifo,
+    //! Threads take the newest task from their own line and deque, and the oldest task from the
+    //! lines and deques of the other threads.
+    hybrid,
+  };
+
+  //! What `enqueue_bounded()` does when the pool is full.
+  enum class overflow_policy {
+    //! Reject the task, as `try_enqueue()` does.
+    reject,
+    //! Execute the task on the calling thread.
+    caller_runs,
+    //! Suspend the caller until the pool has room for the task. While suspended, the calling
+    //! thread helps the pool execute tasks.
+    suspend_producer,
+  };
+
+  //! The configuration parameters of a thread pool.
+  struct config {
+    //! The number of threads in the pool; if negative, use the available hardware concurrency. With
+    //! zero threads, tasks are executed only by the threads that help the pool (see
+    //! `offer_help_until()`).
+    int num_threads{-1};
+    //! The maximum number of threads the pool can have, after calling `set_parallelism()`. If
+    //! smaller than the number of threads, the pool cannot grow beyond its initial size.
+    int max_threads{0};
+    //! The number of coroutine stacks that each worker allocates and pre-faults at startup, so that
+    //! the first spawns don't pay for cold allocations and page faults. The stacks are placed in
+    //! the worker's cache of `stack::default_stack_pool()`; as the cache keeps at most
+    //! `stack::stack_pool::high_watermark()` stacks (32 by default), this is clamped to that.
+    int prewarmed_stacks_per_worker{0};
+    //! The number of bytes at the top of each prewarmed stack that are touched to pre-fault them.
+    std::size_t prefault_size{64 * 1024};
+    //! Whether workers have work-stealing deques; if `false`, all the tasks go to the work lines.
+    bool use_work_stealing_deques{true};
+    //! The capacity of the work-stealing deque of each worker; must be a power of two. When a deque
+    //! is full, the tasks go to the work lines.
+    uint32_t deque_capacity{1024};
+    //! The maximum time an idle thread spins, waiting for new tasks, before going to sleep. The
+    //! actual spinning time adapts to how long the thread recently waited for tasks. Zero disables
+    //! spinning; spinning is also disabled on single-core machines.
+    std::chrono::nanoseconds max_spin_duration{std::chrono::microseconds{50}};
+    //! Every `starvation_limit`-th task a thread picks is taken from the lowest priority that has
+    //! tasks, so that lower-priority tasks are not starved. Zero disables this guarantee.
+    int starvation_limit{32};
+    //! Whether to pin the worker threads to CPUs. Worker `i` is pinned to the `i`-th CPU (modulo
+    //! the number of CPUs) that the process can run on. With pinned workers, threads look for work
+    //! to steal first at their SMT siblings, then in the same L3 cache domain, then on the same
+    //! NUMA node, and only then on remote nodes. The topology is read from
+    //! `/sys/devices/system/cpu`.
+    bool pin_worker_threads{false};
+    //! The order in which tasks are taken from the work lines and from the deques. Stealing from
+    //! the deques of other workers is always done in FIFO order.
+    queue_order order{queue_order::lifo};
+    //! The granularity of the timers (see `enqueue_after()`); deadlines are rounded up to a
+    //! multiple of this.
+    std::chrono::nanoseconds timer_resolution{std::chrono::milliseconds{1}};
+    //! The maximum number of tasks waiting to be executed, as seen by `try_enqueue()` and
+    //! `enqueue_bounded()`; zero means unbounded. Tasks of all the priorities are counted. The
+    //! limit is approximate: far from the limit, the number of pending tasks is only recounted
+    //! from time to time, so concurrent producers may exceed it by a few tasks.
+    int max_pending_tasks{0};
+    //! What `enqueue_bounded()` does when the pool is full.
+    overflow_policy on_overflow{overflow_policy::reject};
+  };
+
+  //! Statistics on how idle threads waited for new tasks.
+  struct spin_stats {
+    //! The number of times an idle thread found new tasks while spinning, without going to sleep.
+    uint64_t parks_avoided{0};
+    //! The number of times an idle thread went to sleep.
+    uint64_t parks{0};
+  };
+
   //! Constructor. Using hardware available parallelism to size the pool of threads.
   thread_pool();
-  //! Constructor. Using specified number of threads.
+  //! Constructor. Using specified number of threads; zero means no worker threads.
   explicit thread_pool(int num_threads);
+  //! Constructor. Using the given configuration.
+  //! If stacks need to be prewarmed, this waits for all the workers to prewarm their stacks.
+  explicit thread_pool(const config& cfg);
   //! Destructor. Waits for all the threads to be done.
   ~thread_pool();
 
@@ -35,16 +159,93 @@ public:
    */
   void enqueue(concore2full_task* task) noexcept;
 
+  /**
+   * @brief Enqueue a task for execution, with the given priority.
+   * @param task The task to be executed on this thread pool.
+   * @param priority The priority of the task.
+   *
+   * Tasks with `task_priority::normal` are enqueued the same way as with `enqueue(task)`.
+   */
+  void enqueue(concore2full_task* task, task_priority priority) noexcept;
+
+  /**
+   * @brief Enqueue a task for execution, if the pool is not full.
+   * @param task The task to be executed on this thread pool.
+   * @return `false` if the task was rejected because the pool is full.
+   *
+   * @sa config::max_pending_tasks
+   */
+  [[nodiscard]] bool try_enqueue(concore2full_task* task) noexcept;
+
+  /**
+   * @brief Enqueue a task for execution, applying `config::on_overflow` if the pool is full.
+   * @param task The task to be executed on this thread pool.
+   * @return `false` if the task was rejected; `true` if the task was enqueued or executed.
+   *
+   * With `overflow_policy::caller_runs`, the task is executed before returning; it receives the
+   * index of the work line of the calling thread, or the index of the extra line (i.e.,
+   * `max_parallelism()`) if the thread doesn't belong to the pool.
+   * With `overflow_policy::suspend_producer`, this waits until the number of pending tasks drops
+   * below the capacity, executing tasks from the pool meanwhile.
+   */
+  bool enqueue_bounded(concore2full_task* task) noexcept;
+
+  /**
+   * @brief Enqueue a task for execution, after the given amount of time.
+   * @param delay The time after which the task is enqueued.
+   * @param task The task to be executed on this thread pool.
+   *
+   * The task is enqueued (as if by calling `enqueue(task)`) once the delay passes, rounded up to
+   * the timer resolution (see `config::timer_resolution`). While waiting for its time, the task
+   * cannot be extracted (see `extract_task()`).
+   */
+  void enqueue_after(std::chrono::steady_clock::duration delay, concore2full_task* task) noexcept;
+
+  /**
+   * @brief Enqueue a task for execution, at the given point in time.
+   * @param deadline The time at which the task is enqueued.
+   * @param task The task to be executed on this thread pool.
+   *
+   * @sa enqueue_after()
+   */
+  void enqueue_at(std::chrono::steady_clock::time_point deadline, concore2full_task* task) noexcept;
+
+  /**
+   * @brief Enqueue a task, to be preferably executed by the given worker thread.
+   * @param worker_index The index of the worker thread; taken modulo the number of threads.
+   * @param task The task to be executed on this thread pool.
+   *
+   * The task is placed in the work line of the worker, and the worker is woken up if sleeping.
+   * If the worker is busy, other threads may still steal the task.
+   */
+  void enqueue_on(int worker_index, concore2full_task* task) noexcept;
+
+  /**
+   * @brief Bulk enqueue a number of tasks, spreading them over the worker threads.
+   * @param tasks Array of tasks that need to be executed.
+   * @param count The number of tasks in the array.
+   *
+   * Task `i` is placed in the work line of worker `i % N`, where `N` is the number of threads, as
+   * if calling `enqueue_on(i, &tasks[i])`. Each work line is locked only once.
+   */
+  template <std::derived_from<concore2full_task> Task>
+  void enqueue_bulk_on_workers(Task* tasks, int count) noexcept {
+    if (count > 0)
+      enqueue_on_workers_impl(tasks, sizeof(Task), count);
+  }
+
   /**
    * @brief Bulk enqueue a number of tasks.
    * @param tasks Array of tasks that need to be executed.
    * @param count The number of tasks in the array.
+   *
+   * The tasks are split into chunks, one for each work line; each chunk is added to its line with
+   * a single lock acquisition. At most one thread is woken up for each chunk.
    */
   template <std::derived_from<concore2full_task> Task>
   void enqueue_bulk(Task* tasks, int count) noexcept {
-    for (int i = 0; i < count; i++) {
-      enqueue(&tasks[i]);
-    }
+    if (count > 0)
+      enqueue_bulk_impl(tasks, sizeof(Task), count);
   }
 
   /**
@@ -65,10 +266,79 @@ public:
   //! Note: must not be called from a thread that was originally part of the thread pool.
   void join() noexcept;
 
-  //! Returns the number of threads in `this`.
-  int available_parallelism() const noexcept { return threads_.size(); }
+  //! Returns the number of active worker threads in `this`.
+  int available_parallelism() const noexcept {
+    return active_workers_.load(std::memory_order_relaxed);
+  }
+
+  //! Returns the maximum number of worker threads that `this` can have.
+  int max_parallelism() const noexcept { return static_cast<int>(work_lines_.size()) - 1; }
+
+  /**
+   * @brief Changes the number of active worker threads.
+   * @param num_threads The desired number of worker threads; clamped to `[1, max_parallelism()]`.
+   *   Pools created without worker threads keep having none.
+   * @return The new number of active worker threads.
+   *
+   * When decreasing the parallelism, the workers with the highest indices are parked after they
+   * finish the tasks they are executing, and after their deques are empty; they are not joined,
+   * but they don't pick new tasks anymore. The tasks that are already enqueued are executed by
+   * the remaining workers. When increasing the parallelism, parked workers are woken up, and new
+   * threads are started, if needed.
+   *
+   * Does nothing if the pool is being joined.
+   */
+  int set_parallelism(int num_threads) noexcept;
+
+  //! Returns the statistics on how the idle threads of this pool waited for new tasks.
+  spin_stats spin_statistics() const noexcept;
+
+  //! Returns a snapshot of the scheduling statistics, summed over all the threads.
+  //! The values are zero if `CONCORE2FULL_SCHEDULER_STATS` is 0.
+  thread_pool_stats stats() const noexcept;
+
+  //! Returns a snapshot of the scheduling statistics of the worker thread with the given index.
+  //! Index `max_parallelism()` corresponds to all the threads that are not workers of this
+  //! pool (e.g., threads helping the pool, or threads enqueueing tasks).
+  thread_pool_stats worker_stats(int worker_index) const noexcept;
 
 private:
+  //! A producer that waits in `enqueue_bounded()` for the pool to have room.
+  struct waiting_producer {
+    //! Stopped to wake up the producer.
+    std::stop_source wakeup_;
+    //! The next producer in the list of waiting producers.
+    waiting_producer* next_{nullptr};
+  };
+
+  //! The tasks that wait to be enqueued at a later time.
+  struct timer_queue {
+    //! The value of `next_expiration_` when there are no timers.
+    static constexpr int64_t none = std::numeric_limits<int64_t>::max();
+
+    //! Mutex protecting `wheel_`.
+    std::mutex bottleneck_;
+    //! The wheel holding the tasks; the ticks are counted from `epoch_`.
+    detail::timer_wheel wheel_;
+    //! The time corresponding to tick 0.
+    std::chrono::steady_clock::time_point epoch_;
+    //! The duration of a tick; see `config::timer_resolution`.
+    std::chrono::nanoseconds resolution_;
+    //! The time at which the wheel needs to be advanced next, as nanoseconds since the epoch of
+    //! `steady_clock`; `none` if there are no timers. Allows checking for timers without locking.
+    std::atomic<int64_t> next_expiration_{none};
+    //! The index of the sleep object of the idle thread that sleeps until `next_expiration_`; -1 if
+    //! no idle thread is waiting for the timers.
+    std::atomic<int> keeper_{-1};
+
+    //! Returns the first tick that is not earlier than `deadline`.
+    uint64_t tick_not_before(std::chrono::steady_clock::time_point deadline) const noexcept;
+    //! Returns the last tick that is not later than `now`.
+    uint64_t tick_not_after(std::chrono::steady_clock::time_point now) const noexcept;
+    //! Returns the time of `tick`, in the format of `next_expiration_`.
+    int64_t time_of(uint64_t tick) const noexcept;
+  };
+
   //! Helper class that is used by threads to go to sleep, and to be woken up.
   class thread_sleep_data {
   public:
@@ -78,7 +348,24 @@ private:
 
     //! Attempts to put the thread to sleep, until the thread is notified or `stop_requested` is
     //! `true`. Returns the `work_line_hint` that was used to wake up the thread.
-    int sleep(std::stop_token stop_condition) noexcept;
+    //! If `pending_tasks` is given, and the object has an idle bit, the bit is set while sleeping;
+    //! if `pending_tasks` becomes positive after setting the idle bit, the thread will not go to
+    //! sleep. Without `pending_tasks`, notifiers cannot find the thread in the idle bitmap. This is
+    //! the only place that recounts `pending_tasks` (refreshing its summary) to decide on idling.
+    //! If `timers` is also given, and there are pending timers, the thread tries to become the
+    //! keeper of the timers; the keeper doesn't sleep past the earliest timer.
+    int sleep(std::stop_token stop_condition, detail::sharded_counter* pending_tasks = nullptr,
+              timer_queue* timers = nullptr) noexcept;
+
+    //! Returns the index of this object in `sleep_objects_`, or -1 if not part of the pool.
+    int index() const noexcept { return index_; }
+
+    //! Associates this object (with index `index`) with the bit `idle_bit` in `idle_word`.
+    void set_idle_bit(int index, std::atomic<uint64_t>* idle_word, uint64_t idle_bit) noexcept {
+      index_ = index;
+      idle_word_ = idle_word;
+      idle_bit_ = idle_bit;
+    }
 
   private:
     //! Token used to wake up the thread.
@@ -89,11 +376,22 @@ private:
     detail::catomic<int> wake_requests_{1};
     //! The work line index to start working from.
     detail::catomic<int> work_line_start_index_{0};
+    //! The word of the idle bitmap in which we announce that we are sleeping; may be null.
+    std::atomic<uint64_t>* idle_word_{nullptr};
+    //! The bit we set in `idle_word_` while we are sleeping.
+    uint64_t idle_bit_{0};
+    //! The index of this object in `sleep_objects_`; -1 if not part of the pool.
+    int index_{-1};
   };
 
   //! Collection of tasks that need to be executed.
   //! Instead of placing all tasks into a single collection, we use multiple such objects to reduce
   //! contention.
+  //!
+  //! While a task is in the list, its `worker_data_` points to the line; this is the claim state
+  //! of the task. Both the threads popping tasks and the extractors claim the task by atomically
+  //! resetting `worker_data_` to null, so that exactly one of them gets the task. A claimed task
+  //! is removed from the list either by its extractor, or by a popping thread that finds it first.
   class work_line {
   public:
     /**
@@ -120,6 +418,8 @@ private:
 
     /**
      * @brief Try popping a task to execute.
+     * @param contended Set to `true` if we failed because the mutex is taken; may be null.
+     * @param oldest If `true`, pop the oldest task in the list, instead of the newest one.
      * @return The task that needs to be executed, or null.
      *
      * If there are no tasks in the list, or if the mutex around the list is taken, this will
@@ -128,9 +428,21 @@ private:
      *
      * @sa pop()
      */
-    [[nodiscard]] concore2full_task* try_pop() noexcept;
+    [[nodiscard]] concore2full_task* try_pop(bool* contended = nullptr,
+                                             bool oldest = false) noexcept;
+
+    /**
+     * @brief Pushes a chain of tasks to the list of tasks, with a single lock acquisition.
+     * @param first The first task of the chain.
+     * @param stride The distance in bytes between consecutive tasks of the chain.
+     * @param count The number of tasks in the chain.
+     *
+     * The tasks are linked together before taking the lock.
+     */
+    void push_bulk(concore2full_task* first, std::size_t stride, int count) noexcept;
 
-    //! Removes `task` from the list of tasks.
+    //! Claims `task` and removes it from the list of tasks. Returns `false`, without taking the
+    //! lock, if the task was already claimed by somebody else.
     bool extract_task(concore2full_task* task) noexcept;
 
   private:
@@ -138,43 +450,241 @@ private:
     std::mutex bottleneck_;
     //! The stack of tasks that need to be executed.
     concore2full_task* tasks_stack_{nullptr};
+    //! The last (oldest) task in `tasks_stack_`; null if the list is empty.
+    concore2full_task* tail_{nullptr};
 
     //! Pushes `task` to the worker, without worrying about the lock.
     void push_unprotected(concore2full_task* task) noexcept;
 
-    //! Pops a task from the worker, without worrying about the lock.
-    [[nodiscard]] concore2full_task* pop_unprotected() noexcept;
+    //! Pops a task from the worker, without worrying about the lock. Skips the claimed tasks.
+    //! If `oldest` is set, pops from the tail of the list, instead of the head.
+    [[nodiscard]] concore2full_task* pop_unprotected(bool oldest) noexcept;
+
+    //! Removes `task` from the list, without worrying about the lock.
+    void unlink_unprotected(concore2full_task* task) noexcept;
+  };
+
+  //! The work lines for the tasks of a non-normal priority.
+  struct priority_lines {
+    //! The work lines holding the tasks.
+    std::vector<work_line> lines_;
+    //! The number of tasks in `lines_`. Incremented before pushing tasks, so it's never smaller
+    //! than the actual number of tasks in the lines.
+    std::atomic<int> num_tasks_{0};
+
+    //! Returns `true` if `line` is one of our lines.
+    bool contains(const work_line* line) const noexcept {
+      return line >= lines_.data() && line < lines_.data() + lines_.size();
+    }
   };
 
   //! Data corresponding to each working thread, containing the list of tasks that need to be
   //! executed.
   std::vector<work_line> work_lines_;
-  //! The number of tasks that are currently in the thread pool.
-  std::atomic<int> num_tasks_;
+  //! The work lines for high-priority tasks.
+  priority_lines high_priority_;
+  //! The work lines for low-priority tasks.
+  priority_lines low_priority_;
+  //! See `config::starvation_limit`.
+  int starvation_limit_;
+  //! See `config::order`.
+  queue_order order_;
+  //! For each worker, the other workers ordered by their distance in the CPU topology; used to
+  //! decide where to steal work from. Empty if the workers are not pinned to CPUs.
+  std::vector<std::vector<int>> steal_orders_;
+  //! The work-stealing deques of the worker threads; empty if the deques are not used.
+  std::vector<std::unique_ptr<detail::work_stealing_deque>> deques_;
+  //! The tasks that are scheduled to be enqueued later.
+  timer_queue timers_;
+  //! The number of tasks that are currently in the thread pool. Sharded by work line, so that
+  //! threads enqueueing and executing tasks don't contend on the same cache line; see
+  //! `counter_shard()`.
+  detail::sharded_counter num_tasks_;
+  //! See `config::max_pending_tasks`.
+  int64_t max_pending_tasks_;
+  //! See `config::on_overflow`.
+  overflow_policy on_overflow_;
+  //! How often, in checks per thread, the number of pending tasks is recounted when the pool is far
+  //! from being full; see `is_full()`.
+  int64_t pending_check_interval_;
+  //! The number of pending tasks, as last recounted; cheap to read, but possibly stale.
+  alignas(64) std::atomic<int64_t> pending_summary_{0};
+  //! Mutex protecting the list of waiting producers.
+  std::mutex producers_bottleneck_;
+  //! The producers waiting for the pool to have room, in the order they started waiting.
+  waiting_producer* producers_head_{nullptr};
+  //! The last producer in the list of waiting producers.
+  waiting_producer* producers_tail_{nullptr};
+  //! The number of producers in the list; allows checking for waiting producers without locking.
+  std::atomic<int> num_waiting_producers_{0};
 
-  //! The index of the next line to get new tasks. We use unsigned integers as we want this value
-  //! to nicely wrap around. The value can be bigger than the actual number of work lines.
+  //! The index of the next line to get new tasks from threads outside of the pool. We use unsigned
+  //! integers as we want this value to nicely wrap around. The value can be bigger than the actual
+  //! number of work lines.
   std::atomic<uint32_t> line_to_push_to_{0};
 
+  //! The maximum time an idle thread spins before going to sleep; see `config::max_spin_duration`.
+  std::chrono::nanoseconds max_spin_duration_;
+  //! The number of threads that are currently spinning, waiting for tasks. While there are spinning
+  //! threads, notifiers don't need to wake up sleeping threads.
+  std::atomic<int> num_spinning_{0};
+  //! The number of times spinning avoided going to sleep.
+  std::atomic<uint64_t> parks_avoided_{0};
+  //! The number of times idle threads went to sleep.
+  std::atomic<uint64_t> parks_{0};
+
   //! The global stop source that can be used to stop all the threads.
   std::stop_source global_shutdown_;
 
   //! The objects used to help the threads to sleep and wake up.
   std::vector<thread_sleep_data> sleep_objects_;
 
+  //! Bitmap indicating which of the sleep objects are used by sleeping threads. Bit `i % 64` of
+  //! word `i / 64` corresponds to `sleep_objects_[i]`. Allows notifiers to find sleeping threads
+  //! without visiting all the sleep objects.
+  std::vector<std::atomic<uint64_t>> idle_bitmap_;
+
   //! The indices of free sleep objects, in the sleep_objects_ vector.
-  //! All the indices here will be greather than `threads_.size()`, as the first `threads_.size()`
-  //! objects are reserved for our own worker threads.
+  //! All the indices here will be greather than `max_parallelism()`, as the first
+  //! `max_parallelism()` objects are reserved for our own worker threads.
   std::vector<int> free_sleep_objects_;
 
   //! Mutex used to protect `free_sleep_objects_`.
   std::mutex free_sleep_objects_bottleneck_;
 
-  //! The threads that are doing the work.
+  //! The threads that are doing the work. Worker `i` is `threads_[i]`; it may be parked.
   std::vector<std::thread> threads_;
 
+  //! The number of active worker threads; workers with higher indices are parked.
+  std::atomic<int> active_workers_{0};
+
+  //! Mutex used to protect `threads_` while changing the parallelism of the pool.
+  std::mutex threads_bottleneck_;
+
+  //! The configuration the pool was created with; used when starting new workers.
+  config config_;
+
+  //! The CPU to pin each worker to; -1 if the worker is not pinned.
+  std::vector<int> worker_cpus_;
+
+  //! The counters for the scheduling statistics of one thread. Aligned to a cache line, so that
+  //! threads don't interfere when updating their counters.
+  struct alignas(64) thread_counters {
+    std::atomic<uint64_t> tasks_executed_{0};
+    std::atomic<uint64_t> tasks_stolen_{0};
+    std::atomic<uint64_t> pops_contended_{0};
+    std::atomic<uint64_t> pops_empty_{0};
+    std::atomic<uint64_t> sleeps_{0};
+    std::atomic<uint64_t> wakeups_{0};
+    std::atomic<uint64_t> tasks_extracted_{0};
+  };
+  //! The counters of each worker thread, followed by the counters shared by all the other threads.
+  //! Null if `CONCORE2FULL_SCHEDULER_STATS` is 0.
+  std::unique_ptr<thread_counters[]> counters_;
+
+  //! Returns the counters to be updated by the current thread.
+  thread_counters& current_counters() noexcept;
+
+  //! Tries to pop a task from the line with index `index` out of `lines`, counting the failures in
+  //! the scheduling statistics. Takes the oldest or the newest task, according to `order_`.
+  concore2full_task* try_pop_from(std::vector<work_line>& lines, int index) noexcept;
+
+  //! Returns `true` if the current thread should take the oldest task from line or deque `index`.
+  bool takes_oldest_from(int index) const noexcept;
+
   void notify_one(int work_line_hint) noexcept;
 
+  //! Returns `true` if the number of pending tasks reached `max_pending_tasks_`. Far from the
+  //! limit, this only reads `pending_summary_`, recounting the tasks every
+  //! `pending_check_interval_` calls on a thread.
+  bool is_full() noexcept;
+
+  //! Same as `is_full()`, but always recounts the pending tasks.
+  bool is_full_now() noexcept;
+
+  //! Suspends the current execution until the pool is not full, helping the pool meanwhile.
+  void wait_for_room() noexcept;
+
+  //! Called after tasks are removed from the pool; wakes up a waiting producer, if the pool has
+  //! room again. Unless `pool_drained` is set, this only recounts the pending tasks every
+  //! `pending_check_interval_` calls on a thread.
+  void wake_waiting_producer(bool pool_drained) noexcept;
+
+  //! Enqueues the timer tasks whose deadlines have passed. Does nothing if another thread is
+  //! already doing this.
+  void fire_expired_timers() noexcept;
+
+  //! If the thread using sleep object `sleep_index` is the keeper of the timers, gives up this
+  //! role, and wakes up an idle thread to take it over, if there are still pending timers.
+  void release_timer_keeper(int sleep_index) noexcept;
+
+  //! Records that `num_tasks` tasks were added to consecutive work lines, starting with
+  //! `first_line`, and wakes up to `num_lines` sleeping threads to execute them.
+  void notify_bulk(int num_tasks, int first_line, int num_lines) noexcept;
+
+  //! Wakes up to `max_count` threads that are marked as sleeping in `idle_bitmap_`; the i-th woken
+  //! thread is asked to start with work line `first_line + i`. Returns the number of threads woken.
+  int wake_idle_threads(int max_count, int first_line) noexcept;
+
+  //! Returns the shard of `num_tasks_` to be updated by the current thread.
+  int counter_shard() const noexcept;
+
+  //! Returns the index of the line to push a new task to: the own line of the current thread, or
+  //! the next line in round-robin order.
+  uint32_t line_to_push_to() noexcept;
+
+  //! Pushes `task` to one of `lines`, starting with the line `index`; prefers lines that are not
+  //! locked. Returns the index of the line the task was pushed to.
+  static uint32_t push_to_lines(std::vector<work_line>& lines, uint32_t index,
+                                concore2full_task* task) noexcept;
+
+  //! Pops a task from `lines`, starting with `index_hint`. On success, sets `index` to the index of
+  //! the line the task was taken from.
+  concore2full_task* pop_from(priority_lines& lines, int index_hint, int& index) noexcept;
+
+  //! Pops a normal-priority task, looking in the deque of the current worker thread, in the work
+  //! lines, and then trying to steal from the other deques.
+  concore2full_task* pop_normal_priority(int index_hint, int& index) noexcept;
+
+  //! Starts the worker thread with index `index`, counting down `prewarmed` after the thread
+  //! prewarms its stacks. Must be called with `threads_bottleneck_` held, for indices in order.
+  void start_worker(int index, std::shared_ptr<std::latch> prewarmed);
+
+  //! Parks the worker loop using `sleep_object`, if the index of the worker is not below the number
+  //! of active workers. Returns `true` if the loop was parked (and woken up again).
+  bool park_if_inactive(std::stop_token stop_condition, thread_sleep_data& sleep_object) noexcept;
+
+  //! Wakes up the thread using sleep object `index`, if it's marked as sleeping in `idle_bitmap_`.
+  //! Returns `true` if the thread was marked as sleeping.
+  bool wake_idle_thread(int index, int work_line_hint) noexcept;
+
+  //! Enqueues `count` tasks, placed `stride` bytes apart, starting with `first`, spreading them
+  //! over the work lines of the worker threads.
+  void enqueue_on_workers_impl(concore2full_task* first, std::size_t stride, int count) noexcept;
+
+  //! Enqueues `count` tasks, placed `stride` bytes apart, starting with `first`.
+  void enqueue_bulk_impl(concore2full_task* first, std::size_t stride, int count) noexcept;
+
+  //! Spins until there are tasks in the pool, `stop_condition` is set, or `budget` expires.
+  //! Returns `true` if there are tasks to execute.
+  bool spin_until_work(std::stop_token stop_condition, std::chrono::nanoseconds budget) noexcept;
+
+  //! Returns the index of the worker thread of this pool that we are running on, or -1 if we are
+  //! not running on a worker thread of this pool.
+  int current_worker_index() const noexcept;
+
+  //! Returns the index of the work line that the current thread is using, or -1 if the current
+  //! thread is neither a worker thread of this pool, nor helping this pool.
+  int current_line_index() const noexcept;
+
+  //! Returns the order in which the current worker thread should steal from the other workers, or
+  //! null if there is no topology-aware order.
+  const std::vector<int>* steal_order() const noexcept;
+
+  //! Tries to steal a task from the deques of the worker threads, starting with `index_hint`.
+  //! On success, sets `index` to the index of the deque from which the task was stolen.
+  concore2full_task* steal_from_deques(int index_hint, int& index) noexcept;
+
   /**
    * @brief The main function to be executed by the worker threads
    * @param index The index of the current thread.
@@ -0,0 +1,19 @@
+#pragma once
+
+namespace concore2full {
+
+//! Hint that work should preferably be executed by the worker thread with the given index. The
+//! index is taken modulo the number of worker threads. Other threads may still steal the work.
+struct worker_affinity {
+  int worker_index{0};
+};
+
+//! Tag type used to request that the work items of a bulk operation are spread over the worker
+//! threads: work item `i` is preferably executed by worker `i % N`, where `N` is the number of
+//! worker threads.
+struct round_robin_workers_t {};
+//! Tag value used to request that the work items of a bulk operation are spread over the worker
+//! threads.
+inline constexpr round_robin_workers_t round_robin_workers{};
+
+} // namespace concore2full
@@ -71,7 +71,7 @@ void bulk_spawn_frame_base::execute_bulk_spawn_task(concore2full_task* t, int) n
   auto task = reinterpret_cast<concore2full_bulk_spawn_task*>(t);
   auto frame = task->base_;
   int index = (int)(task - frame->tasks_);
-  (void)callcc([frame, index](continuation_t thread_cont) -> continuation_t {
+  auto coro_fun = [frame, index](continuation_t thread_cont) -> continuation_t {
     // Store the current continuation, so that other threads can extract it.
     int cont_index = frame->store_worker_continuation(thread_cont);
 
@@ -94,7 +94,8 @@ void bulk_spawn_frame_base::execute_bulk_spawn_task(concore2full_task* t, int) n
 
       return r;
     }
-  });
+  };
+  (void)callcc(std::allocator_arg, frame->stack_allocator_, std::move(coro_fun));
 }
 
 uint64_t bulk_spawn_frame_base::frame_size(int32_t count) {
@@ -104,7 +105,26 @@ uint64_t bulk_spawn_frame_base::frame_size(int32_t count) {
       ;
 }
 
-void bulk_spawn_frame_base::spawn(int32_t count, concore2full_bulk_spawn_function_t f) {
+void bulk_spawn_frame_base::spawn(int32_t count, concore2full_bulk_spawn_function_t f,
+                                  stack::any_stack_allocator salloc) {
+  prepare(count, f, salloc, concore2full::global_thread_pool());
+  pool_->enqueue_bulk(tasks_, count);
+}
+
+void bulk_spawn_frame_base::spawn(int32_t count, concore2full_bulk_spawn_function_t f,
+                                  stack::any_stack_allocator salloc, round_robin_workers_t) {
+  prepare(count, f, salloc, concore2full::global_thread_pool());
+  pool_->enqueue_bulk_on_workers(tasks_, count);
+}
+
+void bulk_spawn_frame_base::spawn(int32_t count, concore2full_bulk_spawn_function_t f,
+                                  stack::any_stack_allocator salloc, thread_pool& pool) {
+  prepare(count, f, salloc, pool);
+  pool_->enqueue_bulk(tasks_, count);
+}
+
+void bulk_spawn_frame_base::prepare(int32_t count, concore2full_bulk_spawn_function_t f,
+                                    stack::any_stack_allocator salloc, thread_pool& pool) {
   size_t size_struct = sizeof(bulk_spawn_frame_base);
   size_t size_tasks = count * sizeof(concore2full_bulk_spawn_task);
   char* p = reinterpret_cast<char*>(this);
@@ -116,6 +136,8 @@ void bulk_spawn_frame_base::spawn(int32_t count, concore2full_bulk_spawn_functio
   completed_tasks_ = 0;
   finalized_tasks_ = 0;
   user_function_ = f;
+  stack_allocator_ = salloc;
+  pool_ = &pool;
   for (int i = 0; i < count; i++) {
     tasks_[i].task_function_ = &execute_bulk_spawn_task;
     tasks_[i].next_ = nullptr;
@@ -124,8 +146,6 @@ void bulk_spawn_frame_base::spawn(int32_t count, concore2full_bulk_spawn_functio
   for (int i = 0; i < count + 1; i++) {
     threads_[i] = catomic<continuation_t>{};
   }
-
-  concore2full::global_thread_pool().enqueue_bulk(tasks_, count);
 }
 
 void bulk_spawn_frame_base::await() {
@@ -138,7 +158,7 @@ void bulk_spawn_frame_base::await() {
 
   // Try to execute as much as possible inplace.
   for (uint32_t i = 0; i < count_; i++) {
-    if (concore2full::global_thread_pool().extract_task(&tasks_[i])) {
+    if (pool_->extract_task(&tasks_[i])) {
       // Occupy one slot in the completed tasks.
       store_worker_continuation(tombstone_continuation());
 
@@ -153,7 +173,7 @@ void bulk_spawn_frame_base::await() {
   }
 
   // We may need to switching threads, so we need a continuation.
-  auto c = callcc([this](continuation_t await_cc) -> continuation_t {
+  auto coro_fun = [this](continuation_t await_cc) -> continuation_t {
     // Store the current continuation, so that other threads can extract it.
     // We always store the continuation at `count_` position, so that this is the last one to be
     // extracted.
@@ -170,7 +190,8 @@ void bulk_spawn_frame_base::await() {
     finalize_thread_of_execution(last_thread);
 
     return r;
-  });
+  };
+  auto c = callcc(std::allocator_arg, stack_allocator_, std::move(coro_fun));
   (void)c;
   // This point will be executed by the thread that finishes last.
 }
@@ -28,13 +28,16 @@ enum sync_state_values {
 
 } // namespace
 
-void copyable_spawn_frame_base::spawn(concore2full_spawn_function_t f) {
+void copyable_spawn_frame_base::spawn(concore2full_spawn_function_t f,
+                                      stack::any_stack_allocator salloc) {
   sync_state_.set_name("sync_state");
   task_.task_function_ = &execute_spawn_task;
   task_.next_ = nullptr;
   sync_state_ = ss_initial_state;
   user_function_ = f;
-  concore2full::global_thread_pool().enqueue(&task_);
+  stack_allocator_ = salloc;
+  pool_ = &concore2full::global_thread_pool();
+  pool_->enqueue(&task_);
 }
 void copyable_spawn_frame_base::await() {
   concore2full::profiling::zone zone{CURRENT_LOCATION()};
@@ -43,7 +46,7 @@ void copyable_spawn_frame_base::await() {
 
     // If the async work hasn't started yet, check if we can execute it here directly.
     if (sync_state_.load(std::memory_order_acquire) == ss_initial_state) {
-      if (concore2full::global_thread_pool().extract_task(&task_)) {
+      if (pool_->extract_task(&task_)) {
         concore2full::profiling::zone z{CURRENT_LOCATION_N("execute inplace")};
         // We've extracted the task from the queue; execute it here directly.
         user_function_(to_interface());
@@ -62,14 +65,15 @@ void copyable_spawn_frame_base::await() {
     uint32_t expected{ss_async_started};
     if (sync_state_.compare_exchange_strong(expected, ss_main_finishing)) {
       // We are the first to finish; we need to start switching threads.
-      auto c = callcc([this](continuation_t await_cc) -> continuation_t {
+      auto coro_fun = [this](continuation_t await_cc) -> continuation_t {
         first_await_ = await_cc;
         auto continue_with = secondary_thread_;
         // We are done "finishing".
         sync_state_.store(ss_main_finished, std::memory_order_release);
         // Complete the thread switching.
         return continue_with;
-      });
+      };
+      auto c = callcc(std::allocator_arg, stack_allocator_, std::move(coro_fun));
       (void)c;
     } else {
       // The async thread is finising or finished; ensure that it's finished
@@ -87,7 +91,7 @@ void copyable_spawn_frame_base::await() {
     }
 
     // Suspend the current thread; let the worker wake us up,
-    suspend_quick_resume(suspend_token_);
+    suspend_quick_resume(*pool_, suspend_token_);
   }
 }
 
@@ -126,7 +130,7 @@ continuation_t copyable_spawn_frame_base::on_async_complete(continuation_t c) {
 void copyable_spawn_frame_base::execute_spawn_task(concore2full_task* task, int) noexcept {
   auto self =
       (copyable_spawn_frame_base*)((char*)task - offsetof(copyable_spawn_frame_base, task_));
-  (void)callcc([self](continuation_t thread_cont) -> continuation_t {
+  auto coro_fun = [self](continuation_t thread_cont) -> continuation_t {
     // Assume there will be a thread switch and store required objects.
     self->secondary_thread_ = thread_cont;
     // Signal the fact that we have started (and the continuation is properly stored).
@@ -135,5 +139,6 @@ void copyable_spawn_frame_base::execute_spawn_task(concore2full_task* task, int)
     self->user_function_(self->to_interface());
     // Complete the async processing.
     return self->on_async_complete(thread_cont);
-  });
+  };
+  (void)callcc(std::allocator_arg, self->stack_allocator_, std::move(coro_fun));
 }
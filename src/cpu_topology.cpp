@@ -0,0 +1,166 @@
+#include "concore2full/detail/cpu_topology.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace concore2full::detail {
+
+namespace {
+
+//! Reads the integer stored in file `path`; returns `default_value` if it cannot be read.
+int read_int(const std::filesystem::path& path, int default_value = -1) {
+  std::ifstream f{path};
+  int value{default_value};
+  if (!(f >> value))
+    return default_value;
+  return value;
+}
+
+//! Parses a CPU list, like "0-3,8,10-11".
+std::vector<int> parse_cpu_list(const std::string& text) {
+  std::vector<int> result;
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t end = text.find(',', pos);
+    if (end == std::string::npos)
+      end = text.size();
+    std::string item = text.substr(pos, end - pos);
+    size_t dash = item.find('-');
+    try {
+      int first = std::stoi(item.substr(0, dash));
+      int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+      for (int c = first; c <= last; c++)
+        result.push_back(c);
+    } catch (...) {
+      // Ignore malformed items.
+    }
+    pos = end + 1;
+  }
+  return result;
+}
+
+//! Returns `true` if the current thread is allowed to run on `cpu`.
+bool is_allowed_cpu(int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) != 0)
+    return true;
+  return cpu < CPU_SETSIZE && CPU_ISSET(cpu, &set);
+#else
+  (void)cpu;
+  return true;
+#endif
+}
+
+//! Returns the ID of the L3 cache of the CPU described in `cpu_dir`, or -1 if unknown.
+int read_l3_id(const std::filesystem::path& cpu_dir) {
+  std::error_code ec;
+  for (const auto& entry : std::filesystem::directory_iterator(cpu_dir / "cache", ec)) {
+    if (entry.path().filename().string().rfind("index", 0) != 0)
+      continue;
+    if (read_int(entry.path() / "level") != 3)
+      continue;
+    int id = read_int(entry.path() / "id");
+    if (id >= 0)
+      return id;
+    // Older kernels don't have the `id` file; use the first CPU sharing the cache.
+    std::ifstream f{entry.path() / "shared_cpu_list"};
+    std::string text;
+    if (std::getline(f, text)) {
+      auto cpus = parse_cpu_list(text);
+      if (!cpus.empty())
+        return cpus.front();
+    }
+  }
+  return -1;
+}
+
+//! Returns the NUMA node of the CPU described in `cpu_dir`, or -1 if unknown.
+int read_node_id(const std::filesystem::path& cpu_dir) {
+  std::error_code ec;
+  for (const auto& entry : std::filesystem::directory_iterator(cpu_dir, ec)) {
+    std::string name = entry.path().filename().string();
+    if (name.size() > 4 && name.rfind("node", 0) == 0) {
+      try {
+        return std::stoi(name.substr(4));
+      } catch (...) {
+      }
+    }
+  }
+  return -1;
+}
+
+} // namespace
+
+std::vector<cpu_info> read_cpu_topology(const std::string& sysfs_cpu_root) {
+  std::filesystem::path root{sysfs_cpu_root};
+  std::ifstream online_file{root / "online"};
+  std::string online;
+  if (!std::getline(online_file, online))
+    return {};
+  bool check_affinity = sysfs_cpu_root == "/sys/devices/system/cpu";
+
+  std::vector<cpu_info> result;
+  for (int cpu : parse_cpu_list(online)) {
+    if (check_affinity && !is_allowed_cpu(cpu))
+      continue;
+    auto cpu_dir = root / ("cpu" + std::to_string(cpu));
+    cpu_info info;
+    info.cpu_ = cpu;
+    info.core_id_ = read_int(cpu_dir / "topology" / "core_id");
+    info.package_id_ = read_int(cpu_dir / "topology" / "physical_package_id");
+    info.l3_id_ = read_l3_id(cpu_dir);
+    info.node_id_ = read_node_id(cpu_dir);
+    result.push_back(info);
+  }
+  return result;
+}
+
+int cpu_distance(const cpu_info& a, const cpu_info& b) noexcept {
+  if (a.cpu_ == b.cpu_)
+    return 0;
+  bool same_package = a.package_id_ == b.package_id_;
+  if (same_package && a.core_id_ >= 0 && a.core_id_ == b.core_id_)
+    return 1;
+  if (same_package && a.l3_id_ >= 0 && a.l3_id_ == b.l3_id_)
+    return 2;
+  if (a.node_id_ >= 0 ? a.node_id_ == b.node_id_ : same_package)
+    return 3;
+  return 4;
+}
+
+std::vector<int> topology_steal_order(const std::vector<cpu_info>& worker_cpus, int self) {
+  int count = worker_cpus.size();
+  std::vector<int> result;
+  result.reserve(count - 1);
+  for (int i = 1; i < count; i++)
+    result.push_back((self + i) % count);
+  std::stable_sort(result.begin(), result.end(), [&](int a, int b) {
+    return cpu_distance(worker_cpus[self], worker_cpus[a]) <
+           cpu_distance(worker_cpus[self], worker_cpus[b]);
+  });
+  return result;
+}
+
+bool pin_current_thread_to_cpu(int cpu) noexcept {
+#ifdef __linux__
+  if (cpu < 0 || cpu >= CPU_SETSIZE)
+    return false;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+} // namespace concore2full::detail
@@ -0,0 +1,200 @@
+#include "concore2full/stack/hugepage_stack_allocator.h"
+#include "concore2full/detail/stack_accounting.h"
+#include "concore2full/profiling.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <new>
+#include <string>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace concore2full::stack {
+
+namespace {
+//! Rounds `size` up to a multiple of `alignment`.
+std::size_t round_up(std::size_t size, std::size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+//! Returns the size of a normal memory page.
+std::size_t page_size() {
+  static const std::size_t value = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  return value;
+}
+
+//! Reads the default huge page size from `/proc/meminfo`; returns 0 if it cannot be read.
+std::size_t read_huge_page_size() {
+  try {
+    std::ifstream f{"/proc/meminfo"};
+    std::string key;
+    while (f >> key) {
+      if (key == "Hugepagesize:") {
+        std::size_t value{0};
+        std::string unit;
+        if (!(f >> value >> unit) || unit != "kB")
+          return 0;
+        return value * 1024;
+      }
+      // Skip the rest of the line.
+      f.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+  } catch (...) {
+  }
+  return 0;
+}
+
+//! Reads the size of the transparent huge pages from sysfs; returns 0 if it cannot be read.
+std::size_t read_transparent_huge_page_size() {
+  try {
+    std::ifstream f{"/sys/kernel/mm/transparent_hugepage/hpage_pmd_size"};
+    std::size_t value{0};
+    if (f >> value)
+      return value;
+  } catch (...) {
+  }
+  return 0;
+}
+
+//! Returns `size` if it is a valid huge page size, or `fallback` (at least a page) otherwise.
+std::size_t valid_huge_page_size(std::size_t size) {
+  constexpr std::size_t fallback = 2 * 1024 * 1024;
+  if (size < page_size() || !std::has_single_bit(size))
+    return std::max(fallback, page_size());
+  return size;
+}
+} // namespace
+
+//! A free stack, as stored in the free list.
+//! The node is placed at the top of the stack memory.
+struct hugepage_stack_slab::free_node {
+  //! The next free stack in the list.
+  free_node* next_{nullptr};
+};
+
+hugepage_stack_slab::hugepage_stack_slab() : hugepage_stack_slab(config{}) {}
+
+hugepage_stack_slab::hugepage_stack_slab(const config& cfg)
+    : stack_size_(round_up(cfg.stack_size, page_size())),
+      region_size_(
+          round_up(std::max(cfg.region_size, stack_size_), transparent_huge_page_size())) {
+  assert(stack_size_ > sizeof(free_node));
+}
+
+hugepage_stack_slab::~hugepage_stack_slab() {
+  std::size_t count = 0;
+  for (free_node* node = free_list_; node; node = node->next_)
+    count++;
+  detail::on_stacks_uncached(count, stack_size_);
+  for (auto [start, size] : regions_)
+    ::munmap(start, size);
+}
+
+stack_t hugepage_stack_slab::allocate() {
+  profiling::zone zone{CURRENT_LOCATION()};
+  std::lock_guard lock{bottleneck_};
+  if (free_list_) {
+    free_node* node = free_list_;
+    free_list_ = node->next_;
+    detail::on_stacks_uncached(1, stack_size_);
+    return {stack_size_, reinterpret_cast<char*>(node) + sizeof(free_node)};
+  }
+  if (region_end_ - region_cur_ < static_cast<std::ptrdiff_t>(stack_size_))
+    map_region();
+  region_cur_ += stack_size_;
+  return {stack_size_, region_cur_};
+}
+
+void hugepage_stack_slab::deallocate(stack_t stack) {
+  profiling::zone zone{CURRENT_LOCATION()};
+  assert(stack.size == stack_size_);
+  auto* node_addr = static_cast<char*>(stack.sp) - sizeof(free_node);
+  std::lock_guard lock{bottleneck_};
+  free_list_ = new (node_addr) free_node{free_list_};
+  detail::on_stacks_cached(1, stack_size_);
+}
+
+std::size_t hugepage_stack_slab::region_count() const noexcept {
+  std::lock_guard lock{bottleneck_};
+  return regions_.size();
+}
+
+hugepage_stack_slab::page_backing hugepage_stack_slab::backing() const noexcept {
+  std::lock_guard lock{bottleneck_};
+  return last_backing_;
+}
+
+std::size_t hugepage_stack_slab::huge_page_size() noexcept {
+  // Use the default huge page size of the system (e.g., 1 GiB, or 512 MiB on aarch64 with 64K
+  // pages), so that `MAP_HUGETLB` regions are properly sized, and can be unmapped.
+  static const std::size_t value = valid_huge_page_size(read_huge_page_size());
+  return value;
+}
+
+std::size_t hugepage_stack_slab::transparent_huge_page_size() noexcept {
+  // This is the PMD size, which can differ from the default `MAP_HUGETLB` size.
+  static const std::size_t value = valid_huge_page_size(read_transparent_huge_page_size());
+  return value;
+}
+
+void hugepage_stack_slab::map_region() {
+  profiling::zone zone{CURRENT_LOCATION()};
+  constexpr int prot = PROT_READ | PROT_WRITE;
+  constexpr int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+  void* region = MAP_FAILED;
+  std::size_t size = region_size_;
+  page_backing backing = page_backing::normal_pages;
+
+#ifdef MAP_HUGETLB
+  // Try explicit huge pages first; this fails if there are not enough huge pages reserved.
+  // We can't use `MAP_NORESERVE` here: we would get SIGBUS on first touch instead of failing.
+  // The mapping needs to be a multiple of the huge page size; all of it is used for stacks.
+  size = round_up(region_size_, huge_page_size());
+  region = ::mmap(nullptr, size, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (region != MAP_FAILED)
+    backing = page_backing::explicit_huge_pages;
+  else
+    size = region_size_;
+#endif
+
+  if (region == MAP_FAILED) {
+    // Map more than needed, so that we can align the region to the transparent huge page size;
+    // transparent huge pages are only used for aligned memory.
+    std::size_t align = transparent_huge_page_size();
+    std::size_t total = region_size_ + align;
+    void* mem = ::mmap(nullptr, total, prot, flags, -1, 0);
+    if (mem == MAP_FAILED)
+      throw std::bad_alloc();
+    auto start = reinterpret_cast<uintptr_t>(mem);
+    auto aligned = round_up(start, align);
+    // Unmap the unaligned head and the unused tail.
+    if (aligned > start)
+      ::munmap(mem, aligned - start);
+    std::size_t tail = total - (aligned - start) - region_size_;
+    if (tail > 0)
+      ::munmap(reinterpret_cast<void*>(aligned + region_size_), tail);
+    region = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+    if (::madvise(region, region_size_, MADV_HUGEPAGE) == 0)
+      backing = page_backing::transparent_huge_pages;
+#endif
+  }
+
+  try {
+    regions_.push_back({region, size});
+  } catch (...) {
+    ::munmap(region, size);
+    throw;
+  }
+  // Any space left in the previous region is lost.
+  region_cur_ = static_cast<char*>(region);
+  region_end_ = region_cur_ + size;
+  last_backing_ = backing;
+}
+
+} // namespace concore2full::stack
@@ -0,0 +1,72 @@
+#include "concore2full/detail/lazy_spawn_frame_base.h"
+#include "concore2full/detail/atomic_wait.h"
+#include "concore2full/global_thread_pool.h"
+#include "concore2full/profiling.h"
+
+namespace {
+
+using concore2full::detail::lazy_spawn_frame_base;
+
+/*
+Valid transitions:
+ss_initial_state -> ss_async_started --> ss_async_finished
+                                     \-> ss_main_waiting
+*/
+enum sync_state_values {
+  ss_initial_state = 0,
+  ss_async_started,
+  ss_async_finished,
+  ss_main_waiting,
+};
+
+} // namespace
+
+void lazy_spawn_frame_base::spawn(concore2full_spawn_function_t f) {
+  task_.task_function_ = &execute_spawn_task;
+  task_.next_ = nullptr;
+  sync_state_ = ss_initial_state;
+  user_function_ = f;
+  pool_ = &concore2full::global_thread_pool();
+  pool_->enqueue(&task_);
+}
+
+void lazy_spawn_frame_base::await() {
+  // If the async work hasn't started yet, check if we can execute it here directly.
+  if (atomic_load_explicit(&sync_state_, std::memory_order_acquire) == ss_initial_state) {
+    if (pool_->extract_task(&task_)) {
+      concore2full::profiling::zone z{CURRENT_LOCATION_N("execute inplace")};
+      // We've extracted the task from the queue; execute it here directly.
+      user_function_(to_interface());
+      // We are done.
+      return;
+    }
+    // If we are here, the task was already started by the thread pool.
+    concore2full::detail::atomic_wait(sync_state_, [](int v) { return v >= ss_async_started; });
+  }
+
+  uint32_t expected{ss_async_started};
+  if (atomic_compare_exchange_strong(&sync_state_, &expected, ss_main_waiting)) {
+    // The work is still running on the worker's stack; we cannot take over the worker's
+    // continuation, so we suspend until the worker is done.
+    concore2full::profiling::zone z{CURRENT_LOCATION_N("wait lazy spawn")};
+    concore2full::suspend_quick_resume(*pool_, suspend_token_);
+  } else {
+    // The async work is finished; we can continue directly.
+  }
+}
+
+//! The task function that executes the async work.
+void lazy_spawn_frame_base::execute_spawn_task(concore2full_task* task, int) noexcept {
+  auto self = (lazy_spawn_frame_base*)((char*)task - offsetof(lazy_spawn_frame_base, task_));
+  atomic_store_explicit(&self->sync_state_, ss_async_started, std::memory_order_release);
+  // Execute the work directly on the current stack.
+  self->user_function_(self->to_interface());
+
+  uint32_t expected{ss_async_started};
+  if (!atomic_compare_exchange_strong(&self->sync_state_, &expected, ss_async_finished)) {
+    // The awaiting thread is suspended; wake it up.
+    // Work on a copy of the token, as the frame can be destroyed as soon as we notify.
+    concore2full::suspend_token token = self->suspend_token_;
+    token.notify();
+  }
+}
@@ -0,0 +1,241 @@
+#include "concore2full/stack/pooled_stack_allocator.h"
+#include "concore2full/detail/stack_accounting.h"
+#include "concore2full/profiling.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+
+namespace concore2full::stack {
+
+namespace {
+//! Mutex protecting the registration of thread caches with the pools.
+//! Lock order: this mutex is always taken before the mutex of a pool.
+std::mutex g_registry_bottleneck;
+} // namespace
+
+//! A free stack, as stored in the lists of free stacks.
+//! The node is placed at the top of the stack memory, so that it doesn't touch extra pages.
+struct stack_pool::free_node {
+  //! The next free stack in the list.
+  free_node* next_{nullptr};
+};
+
+//! The free stacks that a thread keeps for a pool.
+struct stack_pool::thread_cache {
+  //! The pool that this cache belongs to; null if the pool was destroyed.
+  std::atomic<stack_pool*> pool_;
+  //! The list of free stacks.
+  free_node* head_{nullptr};
+  //! The number of stacks in `head_`.
+  std::size_t count_{0};
+  //! The next cache registered with the same pool.
+  thread_cache* next_in_pool_{nullptr};
+  //! The next cache of the same thread.
+  thread_cache* next_in_thread_{nullptr};
+
+  explicit thread_cache(stack_pool* pool) : pool_(pool) {}
+};
+
+//! The caches of the current thread, for all the pools used by the thread.
+//! When the thread exits, the free stacks are moved to the global lists of the pools.
+struct stack_pool::thread_caches {
+  //! The list of caches for this thread.
+  thread_cache* head_{nullptr};
+  //! The last used cache; used to speed up the lookup.
+  thread_cache* last_used_{nullptr};
+
+  ~thread_caches() {
+    std::lock_guard lock{g_registry_bottleneck};
+    while (head_) {
+      thread_cache* cur = head_;
+      head_ = cur->next_in_thread_;
+      stack_pool* pool = cur->pool_.load(std::memory_order_relaxed);
+      if (pool) {
+        pool->spill(*cur, 0);
+        pool->unregister(cur);
+      }
+      delete cur;
+    }
+  }
+};
+
+stack_pool::stack_pool() : stack_pool(config{}) {}
+
+stack_pool::stack_pool(const config& cfg) : config_(cfg) {
+  assert(config_.stack_size > sizeof(free_node));
+  config_.low_watermark = std::min(config_.low_watermark, config_.high_watermark);
+}
+
+stack_pool::~stack_pool() {
+  std::lock_guard lock{g_registry_bottleneck};
+  // Release the stacks cached by the threads, and detach the caches from this pool.
+  while (caches_) {
+    thread_cache* cur = caches_;
+    caches_ = cur->next_in_pool_;
+    release_list(cur->head_);
+    cur->head_ = nullptr;
+    cur->count_ = 0;
+    cur->next_in_pool_ = nullptr;
+    cur->pool_.store(nullptr, std::memory_order_relaxed);
+  }
+  // Release the stacks from the global list.
+  release_list(global_list_);
+  global_list_ = nullptr;
+  global_count_ = 0;
+}
+
+stack_t stack_pool::allocate() {
+  profiling::zone zone{CURRENT_LOCATION()};
+  thread_cache& cache = local_cache();
+  if (!cache.head_)
+    refill(cache);
+  if (cache.head_) {
+    free_node* node = cache.head_;
+    cache.head_ = node->next_;
+    cache.count_--;
+    detail::on_stacks_uncached(1, config_.stack_size);
+    return to_stack(node);
+  }
+  // No free stacks; allocate a new one.
+  return simple_stack_allocator{config_.stack_size}.allocate();
+}
+
+void stack_pool::deallocate(stack_t stack) {
+  profiling::zone zone{CURRENT_LOCATION()};
+  assert(stack.size == config_.stack_size);
+  thread_cache& cache = local_cache();
+  free_node* node = new (to_node(stack)) free_node{cache.head_};
+  cache.head_ = node;
+  cache.count_++;
+  detail::on_stacks_cached(1, config_.stack_size);
+  if (cache.count_ > config_.high_watermark)
+    spill(cache, config_.low_watermark);
+}
+
+std::size_t stack_pool::global_free_count() const noexcept {
+  std::lock_guard lock{bottleneck_};
+  return global_count_;
+}
+
+stack_pool::thread_caches& stack_pool::current_thread_caches() {
+  thread_local thread_caches caches;
+  return caches;
+}
+
+stack_pool::thread_cache& stack_pool::local_cache() {
+  thread_caches& caches = current_thread_caches();
+  // Fast path: the same pool as last time.
+  thread_cache* last = caches.last_used_;
+  if (last && last->pool_.load(std::memory_order_relaxed) == this)
+    return *last;
+
+  std::lock_guard lock{g_registry_bottleneck};
+  // Look for the cache corresponding to this pool; drop the caches of destroyed pools.
+  thread_cache* found = nullptr;
+  thread_cache** link = &caches.head_;
+  while (*link) {
+    thread_cache* cur = *link;
+    stack_pool* pool = cur->pool_.load(std::memory_order_relaxed);
+    if (!pool) {
+      *link = cur->next_in_thread_;
+      delete cur;
+      continue;
+    }
+    if (pool == this)
+      found = cur;
+    link = &cur->next_in_thread_;
+  }
+  // If this thread doesn't have a cache for this pool, register a new one.
+  if (!found) {
+    found = new thread_cache{this};
+    found->next_in_thread_ = caches.head_;
+    caches.head_ = found;
+    found->next_in_pool_ = caches_;
+    caches_ = found;
+  }
+  caches.last_used_ = found;
+  return *found;
+}
+
+void stack_pool::spill(thread_cache& cache, std::size_t keep) noexcept {
+  if (cache.count_ <= keep)
+    return;
+  // Detach the stacks that we need to move.
+  std::size_t n = cache.count_ - keep;
+  free_node* first = cache.head_;
+  free_node* last = first;
+  for (std::size_t i = 1; i < n; i++)
+    last = last->next_;
+  cache.head_ = last->next_;
+  cache.count_ = keep;
+
+  // Add them to the global list, trimming the excess.
+  free_node* to_release = nullptr;
+  {
+    std::lock_guard lock{bottleneck_};
+    last->next_ = global_list_;
+    global_list_ = first;
+    global_count_ += n;
+    if (global_count_ > config_.max_global_stacks) {
+      std::size_t excess = global_count_ - config_.max_global_stacks;
+      to_release = global_list_;
+      free_node* last_released = global_list_;
+      for (std::size_t i = 1; i < excess; i++)
+        last_released = last_released->next_;
+      global_list_ = last_released->next_;
+      last_released->next_ = nullptr;
+      global_count_ = config_.max_global_stacks;
+    }
+  }
+  release_list(to_release);
+}
+
+void stack_pool::refill(thread_cache& cache) noexcept {
+  std::lock_guard lock{bottleneck_};
+  std::size_t n = std::min(std::max<std::size_t>(config_.low_watermark, 1), global_count_);
+  for (std::size_t i = 0; i < n; i++) {
+    free_node* node = global_list_;
+    global_list_ = node->next_;
+    node->next_ = cache.head_;
+    cache.head_ = node;
+  }
+  global_count_ -= n;
+  cache.count_ += n;
+}
+
+void stack_pool::unregister(thread_cache* cache) noexcept {
+  thread_cache** link = &caches_;
+  while (*link && *link != cache)
+    link = &(*link)->next_in_pool_;
+  if (*link)
+    *link = cache->next_in_pool_;
+}
+
+stack_pool::free_node* stack_pool::to_node(stack_t stack) noexcept {
+  return reinterpret_cast<free_node*>(static_cast<char*>(stack.sp) - sizeof(free_node));
+}
+
+stack_t stack_pool::to_stack(free_node* node) const noexcept {
+  return {config_.stack_size, reinterpret_cast<char*>(node) + sizeof(free_node)};
+}
+
+void stack_pool::release_list(free_node* head) const noexcept {
+  simple_stack_allocator upstream{config_.stack_size};
+  std::size_t count = 0;
+  while (head) {
+    free_node* next = head->next_;
+    upstream.deallocate(to_stack(head));
+    head = next;
+    count++;
+  }
+  detail::on_stacks_uncached(count, config_.stack_size);
+}
+
+stack_pool& default_stack_pool() {
+  // Never destroyed: threads may return stacks to this pool during static destruction.
+  static stack_pool* instance = new stack_pool();
+  return *instance;
+}
+
+} // namespace concore2full::stack
@@ -0,0 +1,155 @@
+#include "concore2full/stack/reclaiming_stack_allocator.h"
+#include "concore2full/detail/stack_accounting.h"
+#include "concore2full/profiling.h"
+
+#include <cassert>
+
+#include <sys/mman.h>
+
+namespace concore2full::stack {
+
+//! A free stack, as stored in the cache.
+//! The node is placed at the top of the stack memory; its page is never given back.
+struct reclaiming_stack_cache::free_node {
+  //! The next more recently freed stack.
+  free_node* prev_{nullptr};
+  //! The next less recently freed stack.
+  free_node* next_{nullptr};
+  //! The time at which the stack was freed.
+  clock::time_point released_at_;
+  //! True if the stack still has its pages.
+  bool dirty_{true};
+};
+
+reclaiming_stack_cache::reclaiming_stack_cache() : reclaiming_stack_cache(config{}) {}
+
+reclaiming_stack_cache::reclaiming_stack_cache(const config& cfg)
+    : config_(cfg), upstream_size_(mmap_stack_allocator{cfg.stack_size}.allocate_size()) {
+  assert(upstream_size_ > mmap_stack_allocator::page_size());
+}
+
+reclaiming_stack_cache::~reclaiming_stack_cache() {
+  detail::on_stacks_uncached(count_, upstream_size_);
+  mmap_stack_allocator upstream{upstream_size_};
+  while (head_) {
+    free_node* node = head_;
+    head_ = node->next_;
+    upstream.deallocate(to_stack(node));
+  }
+}
+
+stack_t reclaiming_stack_cache::allocate() {
+  profiling::zone zone{CURRENT_LOCATION()};
+  {
+    std::lock_guard lock{bottleneck_};
+    free_node* node = head_;
+    if (node) {
+      unlink(node);
+      detail::on_stacks_uncached(1, upstream_size_);
+      reclaim_locked(clock::now());
+      return to_stack(node);
+    }
+  }
+  return mmap_stack_allocator{upstream_size_}.allocate();
+}
+
+void reclaiming_stack_cache::deallocate(stack_t stack) {
+  profiling::zone zone{CURRENT_LOCATION()};
+  assert(stack.size == upstream_size_);
+  auto now = clock::now();
+  free_node* to_release = nullptr;
+  {
+    std::lock_guard lock{bottleneck_};
+    free_node* node = new (to_node(stack)) free_node{nullptr, head_, now, true};
+    if (head_)
+      head_->prev_ = node;
+    else
+      tail_ = node;
+    head_ = node;
+    if (!oldest_dirty_)
+      oldest_dirty_ = node;
+    count_++;
+    dirty_bytes_ += upstream_size_;
+    detail::on_stacks_cached(1, upstream_size_);
+    // If we have too many stacks, release the oldest one.
+    if (count_ > config_.max_cached_stacks) {
+      to_release = tail_;
+      unlink(to_release);
+      detail::on_stacks_uncached(1, upstream_size_);
+    }
+    reclaim_locked(now);
+  }
+  if (to_release)
+    mmap_stack_allocator{upstream_size_}.deallocate(to_stack(to_release));
+}
+
+void reclaiming_stack_cache::reclaim() {
+  profiling::zone zone{CURRENT_LOCATION()};
+  std::lock_guard lock{bottleneck_};
+  reclaim_locked(clock::now());
+}
+
+std::size_t reclaiming_stack_cache::cached_count() const noexcept {
+  std::lock_guard lock{bottleneck_};
+  return count_;
+}
+
+std::size_t reclaiming_stack_cache::dirty_bytes() const noexcept {
+  std::lock_guard lock{bottleneck_};
+  return dirty_bytes_;
+}
+
+void reclaiming_stack_cache::reclaim_locked(clock::time_point now) noexcept {
+  // The dirty stacks are ordered by release time; start with the oldest one.
+  while (oldest_dirty_) {
+    bool over_budget = dirty_bytes_ > config_.byte_budget;
+    bool idle = now - oldest_dirty_->released_at_ >= config_.idle_period;
+    if (!over_budget && !idle)
+      break;
+    free_node* node = oldest_dirty_;
+    oldest_dirty_ = node->prev_;
+    release_pages(node);
+  }
+}
+
+void reclaiming_stack_cache::release_pages(free_node* node) noexcept {
+  profiling::zone zone{CURRENT_LOCATION()};
+  // Keep the page containing the node.
+  stack_t stack = to_stack(node);
+  void* begin = static_cast<char*>(stack.sp) - stack.size;
+  std::size_t size = stack.size - mmap_stack_allocator::page_size();
+#ifdef MADV_FREE
+  if (::madvise(begin, size, MADV_FREE) != 0)
+    ::madvise(begin, size, MADV_DONTNEED);
+#else
+  ::madvise(begin, size, MADV_DONTNEED);
+#endif
+  node->dirty_ = false;
+  dirty_bytes_ -= upstream_size_;
+}
+
+void reclaiming_stack_cache::unlink(free_node* node) noexcept {
+  if (node->prev_)
+    node->prev_->next_ = node->next_;
+  else
+    head_ = node->next_;
+  if (node->next_)
+    node->next_->prev_ = node->prev_;
+  else
+    tail_ = node->prev_;
+  if (node == oldest_dirty_)
+    oldest_dirty_ = node->prev_;
+  if (node->dirty_)
+    dirty_bytes_ -= upstream_size_;
+  count_--;
+}
+
+reclaiming_stack_cache::free_node* reclaiming_stack_cache::to_node(stack_t stack) noexcept {
+  return reinterpret_cast<free_node*>(static_cast<char*>(stack.sp) - sizeof(free_node));
+}
+
+stack_t reclaiming_stack_cache::to_stack(free_node* node) const noexcept {
+  return {upstream_size_, reinterpret_cast<char*>(node) + sizeof(free_node)};
+}
+
+} // namespace concore2full::stack
@@ -26,6 +26,11 @@ void sleep_helper::sleep() {
   concore2full::detail::sleep(current_thread_, sleep_id_);
 }
 
+bool sleep_helper::sleep_until(std::chrono::steady_clock::time_point deadline) {
+  concore2full::detail::check_for_thread_switch();
+  return concore2full::detail::sleep_until(current_thread_, sleep_id_, deadline);
+}
+
 wakeup_token sleep_helper::get_wakeup_token() {
   wakeup_token token;
   token.thread_ = &current_thread_;
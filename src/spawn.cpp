@@ -1,11 +1,19 @@
 #include "concore2full/spawn.h"
 #include "concore2full/detail/bulk_spawn_frame_base.h"
 #include "concore2full/detail/spawn_frame_base.h"
+#include "concore2full/stack/mmap_stack_allocator.h"
+#include "concore2full/stack/simple_stack_allocator.h"
 
 namespace {
 
 using concore2full::detail::bulk_spawn_frame_base;
 using concore2full::detail::spawn_frame_base;
+using concore2full::stack::any_stack_allocator;
+using concore2full::stack::mmap_stack_allocator;
+using concore2full::stack::simple_stack_allocator;
+
+static_assert(sizeof(spawn_frame_base) <= sizeof(concore2full_spawn_frame),
+              "concore2full_spawn_frame is too small");
 
 } // namespace
 
@@ -13,6 +21,12 @@ void concore2full_spawn(concore2full_spawn_frame* frame, concore2full_spawn_func
   spawn_frame_base::from_interface(frame)->spawn(f);
 }
 
+void concore2full_spawn_with_allocator(concore2full_spawn_frame* frame,
+                                       concore2full_spawn_function_t f,
+                                       const concore2full_stack_allocator* salloc) {
+  spawn_frame_base::from_interface(frame)->spawn(f, any_stack_allocator{*salloc});
+}
+
 void concore2full_await(concore2full_spawn_frame* frame) {
   spawn_frame_base::from_interface(frame)->await();
 }
@@ -24,10 +38,24 @@ void concore2full_bulk_spawn(struct concore2full_bulk_spawn_frame* frame, int32_
   bulk_spawn_frame_base::from_interface(frame)->spawn(count, f);
 }
 
+void concore2full_bulk_spawn_with_allocator(struct concore2full_bulk_spawn_frame* frame,
+                                            int32_t count, concore2full_bulk_spawn_function_t f,
+                                            const concore2full_stack_allocator* salloc) {
+  bulk_spawn_frame_base::from_interface(frame)->spawn(count, f, any_stack_allocator{*salloc});
+}
+
 void concore2full_bulk_await(struct concore2full_bulk_spawn_frame* frame) {
   bulk_spawn_frame_base::from_interface(frame)->await();
 }
 
+concore2full_stack_allocator concore2full_simple_stack_allocator(uint64_t size) {
+  return any_stack_allocator{simple_stack_allocator{size}}.to_interface();
+}
+
+concore2full_stack_allocator concore2full_mmap_stack_allocator(uint64_t size) {
+  return any_stack_allocator{mmap_stack_allocator{size}}.to_interface();
+}
+
 void concore2full_spawn2(concore2full_spawn_frame* frame, concore2full_spawn_function_t* f) {
   concore2full_spawn(frame, *f);
 }
@@ -15,7 +15,8 @@ using concore2full::detail::spawn_frame_base;
 /*
 Valid transitions:
 ss_initial_state -> ss_async_started --> ss_async_finished
-                                     \-> ss_main_finishing -> ss_main_finished
+                 |                   \-> ss_main_finishing -> ss_main_finished
+                 \-> ss_deferred
 */
 enum sync_state_values {
   ss_initial_state = 0,
@@ -23,21 +24,53 @@ enum sync_state_values {
   ss_async_finished,
   ss_main_finishing,
   ss_main_finished,
+  //! The pool rejected the work; `await()` executes it.
+  ss_deferred,
 };
 
 } // namespace
 
-void spawn_frame_base::spawn(concore2full_spawn_function_t f) {
+void spawn_frame_base::spawn(concore2full_spawn_function_t f, stack::any_stack_allocator salloc,
+                             task_priority priority) {
+  prepare(f, salloc, concore2full::global_thread_pool());
+  pool_->enqueue(&task_, priority);
+}
+void spawn_frame_base::spawn(concore2full_spawn_function_t f, stack::any_stack_allocator salloc,
+                             worker_affinity affinity) {
+  prepare(f, salloc, concore2full::global_thread_pool());
+  pool_->enqueue_on(affinity.worker_index, &task_);
+}
+void spawn_frame_base::spawn(concore2full_spawn_function_t f, stack::any_stack_allocator salloc,
+                             thread_pool& pool) {
+  prepare(f, salloc, pool);
+  pool_->enqueue(&task_);
+}
+void spawn_frame_base::spawn(concore2full_spawn_function_t f, stack::any_stack_allocator salloc,
+                             bounded_pool_hint hint) {
+  prepare(f, salloc, *hint.pool_);
+  if (!pool_->enqueue_bounded(&task_))
+    atomic_store_explicit(&sync_state_, ss_deferred, std::memory_order_relaxed);
+}
+void spawn_frame_base::prepare(concore2full_spawn_function_t f, stack::any_stack_allocator salloc,
+                               thread_pool& pool) {
   task_.task_function_ = &execute_spawn_task;
   task_.next_ = nullptr;
   sync_state_ = ss_initial_state;
   user_function_ = f;
-  concore2full::global_thread_pool().enqueue(&task_);
+  stack_allocator_ = salloc;
+  pool_ = &pool;
 }
 void spawn_frame_base::await() {
+  uint32_t state = atomic_load_explicit(&sync_state_, std::memory_order_acquire);
+  // If the pool rejected the work, execute it here.
+  if (state == ss_deferred) {
+    concore2full::profiling::zone z{CURRENT_LOCATION_N("execute deferred")};
+    user_function_(to_interface());
+    return;
+  }
   // If the async work hasn't started yet, check if we can execute it here directly.
-  if (atomic_load_explicit(&sync_state_, std::memory_order_acquire) == ss_initial_state) {
-    if (concore2full::global_thread_pool().extract_task(&task_)) {
+  if (state == ss_initial_state) {
+    if (pool_->extract_task(&task_)) {
       concore2full::profiling::zone z{CURRENT_LOCATION_N("execute inplace")};
       // We've extracted the task from the queue; execute it here directly.
       user_function_(to_interface());
@@ -52,13 +85,14 @@ void spawn_frame_base::await() {
   uint32_t expected{ss_async_started};
   if (atomic_compare_exchange_strong(&sync_state_, &expected, ss_main_finishing)) {
     // The main thread is first to finish; we need to start switching threads.
-    auto c = callcc([this](continuation_t await_cc) -> continuation_t {
+    auto coro_fun = [this](continuation_t await_cc) -> continuation_t {
       originator_ = await_cc;
       // We are done "finishing".
       atomic_store_explicit(&sync_state_, ss_main_finished, std::memory_order_release);
       // Complete the thread switching.
       return secondary_thread_;
-    });
+    };
+    auto c = callcc(std::allocator_arg, stack_allocator_, std::move(coro_fun));
     (void)c;
   } else {
     // The async thread finished; we can continue directly, no need to switch threads.
@@ -89,7 +123,7 @@ continuation_t spawn_frame_base::on_async_complete(continuation_t c) {
 //! The task function that executes the async work.
 void spawn_frame_base::execute_spawn_task(concore2full_task* task, int) noexcept {
   auto self = (spawn_frame_base*)((char*)task - offsetof(spawn_frame_base, task_));
-  (void)callcc([self](continuation_t thread_cont) -> continuation_t {
+  auto coro_fun = [self](continuation_t thread_cont) -> continuation_t {
     // Assume there will be a thread switch and store required objects.
     self->secondary_thread_ = thread_cont;
     // Signal the fact that we have started (and the continuation is properly stored).
@@ -98,5 +132,6 @@ void spawn_frame_base::execute_spawn_task(concore2full_task* task, int) noexcept
     self->user_function_(self->to_interface());
     // Complete the async processing.
     return self->on_async_complete(thread_cont);
-  });
+  };
+  (void)callcc(std::allocator_arg, self->stack_allocator_, std::move(coro_fun));
 }
@@ -0,0 +1,193 @@
+#include "concore2full/stack/stack_stats.h"
+#include "concore2full/detail/stack_accounting.h"
+#include "concore2full/profiling.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace concore2full::stack {
+
+namespace {
+
+//! The number of shards of the stack counters.
+constexpr int num_shards = 64;
+//! Every how many stack acquisitions a thread samples the peak values.
+constexpr uint32_t peak_sample_interval = 64;
+
+//! The stack counters updated by a group of threads; lives in its own cache line. The values of a
+//! shard can be negative, if stacks are acquired on one shard and released on another.
+struct alignas(64) counters_shard {
+  std::atomic<int64_t> live_stacks_{0};
+  std::atomic<int64_t> live_bytes_{0};
+  std::atomic<int64_t> cached_stacks_{0};
+  std::atomic<int64_t> cached_bytes_{0};
+  std::atomic<uint64_t> total_allocations_{0};
+};
+
+//! The counters used for the stack statistics. Threads update their own shard, so that spawning
+//! and destroying coroutines on different threads doesn't contend on the same cache line; the
+//! statistics are the sums over all the shards.
+struct stack_counters {
+  counters_shard shards_[num_shards];
+  //! The peak values; sampled, as computing the totals requires visiting all the shards.
+  alignas(64) std::atomic<uint64_t> peak_live_stacks_{0};
+  std::atomic<uint64_t> peak_live_bytes_{0};
+  //! Used to assign shards to threads.
+  std::atomic<uint32_t> next_shard_{0};
+
+  stack_counters() {
+    profiling::low_level::define_counter_track(track_id(live_stacks_track), "live_stacks");
+    profiling::low_level::define_counter_track(track_id(live_bytes_track), "live_stack_bytes");
+    profiling::low_level::define_counter_track(track_id(cached_bytes_track), "cached_stack_bytes");
+  }
+
+  //! The counter tracks emitted when profiling.
+  enum track { live_stacks_track, live_bytes_track, cached_bytes_track };
+  //! Returns the ID of the counter track `t`.
+  uint64_t track_id(track t) const noexcept {
+    return reinterpret_cast<uint64_t>(this) + static_cast<uint64_t>(t);
+  }
+};
+
+//! Returns the counters used for the stack statistics.
+stack_counters& counters() {
+  // Never destroyed: coroutines may be destroyed during static destruction.
+  static stack_counters* instance = new stack_counters();
+  return *instance;
+}
+
+//! The index of the shard used by the current thread; -1 until the first use.
+thread_local int tls_shard{-1};
+//! The number of stacks acquired on the current thread; used to sample the peak values.
+thread_local uint32_t tls_acquisitions{0};
+
+//! Returns the shard of the counters used by the current thread.
+counters_shard& current_shard(stack_counters& c) noexcept {
+  if (tls_shard < 0)
+    tls_shard = static_cast<int>(c.next_shard_.fetch_add(1, std::memory_order_relaxed) %
+                                 static_cast<uint32_t>(num_shards));
+  return c.shards_[tls_shard];
+}
+
+//! Returns the sum of `field` over all the shards of `c`, clamped at zero; the shards are read one
+//! by one, so the sum can transiently miss some of the updates.
+uint64_t total(const stack_counters& c, std::atomic<int64_t> counters_shard::*field) noexcept {
+  int64_t sum = 0;
+  for (const auto& s : c.shards_)
+    sum += (s.*field).load(std::memory_order_relaxed);
+  return static_cast<uint64_t>(std::max(sum, int64_t{0}));
+}
+
+//! Makes sure `peak` is at least `value`.
+void update_peak(std::atomic<uint64_t>& peak, uint64_t value) noexcept {
+  uint64_t old = peak.load(std::memory_order_relaxed);
+  while (value > old && !peak.compare_exchange_weak(old, value, std::memory_order_relaxed)) {
+  }
+}
+
+//! Updates the peak values with the current totals; returns the current totals.
+void sample_peaks(stack_counters& c, uint64_t& live_stacks, uint64_t& live_bytes) noexcept {
+  live_stacks = total(c, &counters_shard::live_stacks_);
+  live_bytes = total(c, &counters_shard::live_bytes_);
+  update_peak(c.peak_live_stacks_, live_stacks);
+  update_peak(c.peak_live_bytes_, live_bytes);
+}
+
+//! Emits the values of the counter tracks, if profiling is enabled.
+void emit_counter_values([[maybe_unused]] stack_counters& c) noexcept {
+#if USE_PROFILING_LITE
+  using profiling::low_level::emit_counter_value;
+  using track = stack_counters::track;
+  emit_counter_value(c.track_id(track::live_stacks_track),
+                     static_cast<int64_t>(total(c, &counters_shard::live_stacks_)));
+  emit_counter_value(c.track_id(track::live_bytes_track),
+                     static_cast<int64_t>(total(c, &counters_shard::live_bytes_)));
+  emit_counter_value(c.track_id(track::cached_bytes_track),
+                     static_cast<int64_t>(total(c, &counters_shard::cached_bytes_)));
+#endif
+}
+
+} // namespace
+
+stack_stats get_stack_stats() noexcept {
+  auto& c = counters();
+  stack_stats res;
+  sample_peaks(c, res.live_stacks_, res.live_bytes_);
+  res.peak_live_stacks_ = c.peak_live_stacks_.load(std::memory_order_relaxed);
+  res.peak_live_bytes_ = c.peak_live_bytes_.load(std::memory_order_relaxed);
+  res.cached_stacks_ = total(c, &counters_shard::cached_stacks_);
+  res.cached_bytes_ = total(c, &counters_shard::cached_bytes_);
+  res.total_allocations_ = 0;
+  for (const auto& s : c.shards_)
+    res.total_allocations_ += s.total_allocations_.load(std::memory_order_relaxed);
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  res.timestamp_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+  return res;
+}
+
+double allocation_rate(const stack_stats& older, const stack_stats& newer) noexcept {
+  if (newer.timestamp_ns_ <= older.timestamp_ns_)
+    return 0.0;
+  double allocations = static_cast<double>(newer.total_allocations_ - older.total_allocations_);
+  return allocations * 1e9 / static_cast<double>(newer.timestamp_ns_ - older.timestamp_ns_);
+}
+
+void reset_peak_stack_stats() noexcept {
+  auto& c = counters();
+  c.peak_live_stacks_.store(total(c, &counters_shard::live_stacks_), std::memory_order_relaxed);
+  c.peak_live_bytes_.store(total(c, &counters_shard::live_bytes_), std::memory_order_relaxed);
+}
+
+} // namespace concore2full::stack
+
+namespace concore2full::detail {
+
+void on_stack_acquired(std::size_t size) noexcept {
+  auto& c = stack::counters();
+  auto& shard = stack::current_shard(c);
+  shard.total_allocations_.fetch_add(1, std::memory_order_relaxed);
+  shard.live_stacks_.fetch_add(1, std::memory_order_relaxed);
+  shard.live_bytes_.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+  if (++stack::tls_acquisitions % stack::peak_sample_interval == 0) {
+    uint64_t live_stacks = 0;
+    uint64_t live_bytes = 0;
+    stack::sample_peaks(c, live_stacks, live_bytes);
+  }
+  stack::emit_counter_values(c);
+}
+
+void on_stack_released(std::size_t size) noexcept {
+  auto& c = stack::counters();
+  auto& shard = stack::current_shard(c);
+  shard.live_stacks_.fetch_sub(1, std::memory_order_relaxed);
+  shard.live_bytes_.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+  stack::emit_counter_values(c);
+}
+
+void on_stacks_cached(std::size_t count, std::size_t size) noexcept {
+  auto& c = stack::counters();
+  auto& shard = stack::current_shard(c);
+  shard.cached_stacks_.fetch_add(static_cast<int64_t>(count), std::memory_order_relaxed);
+  shard.cached_bytes_.fetch_add(static_cast<int64_t>(count * size), std::memory_order_relaxed);
+  stack::emit_counter_values(c);
+}
+
+void on_stacks_uncached(std::size_t count, std::size_t size) noexcept {
+  auto& c = stack::counters();
+  auto& shard = stack::current_shard(c);
+  shard.cached_stacks_.fetch_sub(static_cast<int64_t>(count), std::memory_order_relaxed);
+  shard.cached_bytes_.fetch_sub(static_cast<int64_t>(count * size), std::memory_order_relaxed);
+  stack::emit_counter_values(c);
+}
+
+} // namespace concore2full::detail
+
+void concore2full_get_stack_stats(struct concore2full_stack_stats* stats) {
+  *stats = concore2full::stack::get_stack_stats();
+}
+
+double concore2full_stack_allocation_rate(const struct concore2full_stack_stats* older,
+                                          const struct concore2full_stack_stats* newer) {
+  return concore2full::stack::allocation_rate(*older, *newer);
+}
@@ -0,0 +1,158 @@
+#include "concore2full/stack/stack_usage.h"
+#include "concore2full/detail/stack_usage_sampling.h"
+#include "concore2full/profiling.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+namespace concore2full::stack {
+
+namespace {
+
+//! The pattern used to fill the stacks that are sampled.
+constexpr uint64_t canary_pattern = 0xC0DEC0DEC0DEC0DEull;
+
+//! Set if we need to sample the stack usage.
+std::atomic<bool> g_sampling_enabled{false};
+
+//! The collection of all the histograms, one per stack size.
+struct histogram_registry {
+  //! The histograms; never removed, so that we can safely hand out references.
+  std::vector<std::unique_ptr<stack_usage_histogram>> histograms_;
+  //! Mutex protecting `histograms_`.
+  std::mutex bottleneck_;
+};
+
+//! Returns the histogram registry.
+histogram_registry& registry() {
+  // Never destroyed: threads may record samples during static destruction.
+  static histogram_registry* instance = new histogram_registry();
+  return *instance;
+}
+
+//! Returns the bucket index for a stack usage of `used` bytes.
+int bucket_index(std::size_t used) {
+  if (used <= stack_usage_histogram::bucket_upper_bound(0))
+    return 0;
+  int index = static_cast<int>(std::bit_width(used - 1)) - 10;
+  return std::min(index, stack_usage_histogram::num_buckets - 1);
+}
+
+} // namespace
+
+stack_usage_histogram::stack_usage_histogram(std::size_t stack_size) : stack_size_(stack_size) {
+  snprintf(name_, sizeof(name_), "stack_usage_%zu", stack_size);
+  profiling::define_counter_track(max_usage_, name_);
+}
+
+void stack_usage_histogram::record(std::size_t used) noexcept {
+  count_.fetch_add(1, std::memory_order_relaxed);
+  buckets_[bucket_index(used)].fetch_add(1, std::memory_order_relaxed);
+  std::size_t old_max = max_usage_.load(std::memory_order_relaxed);
+  while (used > old_max &&
+         !max_usage_.compare_exchange_weak(old_max, used, std::memory_order_relaxed)) {
+  }
+  profiling::emit_counter_value(max_usage_);
+}
+
+void stack_usage_histogram::reset() noexcept {
+  count_.store(0, std::memory_order_relaxed);
+  max_usage_.store(0, std::memory_order_relaxed);
+  for (auto& b : buckets_)
+    b.store(0, std::memory_order_relaxed);
+}
+
+std::size_t stack_usage_histogram::usage_percentile(double p) const noexcept {
+  uint64_t total = count();
+  if (total == 0)
+    return 0;
+  auto target = static_cast<uint64_t>(std::ceil(p * static_cast<double>(total)));
+  uint64_t seen = 0;
+  for (int i = 0; i < num_buckets; i++) {
+    seen += bucket(i);
+    if (seen >= target)
+      return bucket_upper_bound(i);
+  }
+  return bucket_upper_bound(num_buckets - 1);
+}
+
+void enable_stack_usage_sampling(bool enabled) noexcept {
+  g_sampling_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool stack_usage_sampling_enabled() noexcept {
+  return g_sampling_enabled.load(std::memory_order_relaxed);
+}
+
+stack_usage_histogram& stack_usage_for(std::size_t stack_size) {
+  auto& r = registry();
+  std::lock_guard lock{r.bottleneck_};
+  for (auto& h : r.histograms_) {
+    if (h->stack_size() == stack_size)
+      return *h;
+  }
+  r.histograms_.push_back(std::make_unique<stack_usage_histogram>(stack_size));
+  return *r.histograms_.back();
+}
+
+std::vector<const stack_usage_histogram*> stack_usage_histograms() {
+  auto& r = registry();
+  std::lock_guard lock{r.bottleneck_};
+  std::vector<const stack_usage_histogram*> res;
+  res.reserve(r.histograms_.size());
+  for (auto& h : r.histograms_)
+    res.push_back(h.get());
+  return res;
+}
+
+std::size_t recommended_stack_size(const stack_usage_histogram& usage, std::size_t min_size) {
+  if (usage.count() == 0)
+    return usage.stack_size();
+  std::size_t size = std::max(std::bit_ceil(2 * usage.max_usage()), min_size);
+  return std::min(size, usage.stack_size());
+}
+
+} // namespace concore2full::stack
+
+namespace concore2full::detail {
+
+namespace {
+constexpr uintptr_t word_mask = alignof(uint64_t) - 1;
+
+//! Returns the first aligned word of the stack.
+uint64_t* stack_begin_word(stack::stack_t stack) {
+  auto begin = reinterpret_cast<uintptr_t>(stack.sp) - stack.size;
+  return reinterpret_cast<uint64_t*>((begin + word_mask) & ~word_mask);
+}
+//! Returns the last aligned word before `p`.
+uint64_t* word_before(void* p) {
+  return reinterpret_cast<uint64_t*>(reinterpret_cast<uintptr_t>(p) & ~word_mask);
+}
+} // namespace
+
+stack::stack_usage_histogram* start_stack_usage_sampling(stack::stack_t stack, void* used_end) {
+  if (!stack::stack_usage_sampling_enabled())
+    return nullptr;
+  profiling::zone zone{CURRENT_LOCATION()};
+  auto* begin = stack_begin_word(stack);
+  auto* end = word_before(used_end);
+  std::fill(begin, std::max(begin, end), stack::canary_pattern);
+  return &stack::stack_usage_for(stack.size);
+}
+
+void finish_stack_usage_sampling(stack::stack_usage_histogram* histogram, stack::stack_t stack) {
+  profiling::zone zone{CURRENT_LOCATION()};
+  auto* begin = stack_begin_word(stack);
+  auto* end = word_before(stack.sp);
+  // Find the lowest word that was overwritten.
+  auto* first_used =
+      std::find_if(begin, end, [](uint64_t v) { return v != stack::canary_pattern; });
+  std::size_t used = static_cast<char*>(stack.sp) - reinterpret_cast<char*>(first_used);
+  histogram->record(used);
+}
+
+} // namespace concore2full::detail
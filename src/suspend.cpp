@@ -24,21 +24,42 @@ struct quick_resume_task : concore2full_task {
   continuation_t cont_;
   std::atomic<continuation_t> after_execute_{nullptr};
 };
+
+//! Task that wakes up an execution suspended in `sleep_until()`.
+struct sleep_timer_task : concore2full_task {
+  sleep_timer_task() { task_function_ = &execute; }
+
+  static void execute(struct concore2full_task* task, int worker_index) {
+    auto* self = static_cast<sleep_timer_task*>(task);
+    // Once the stop is requested, `self` can be destroyed; keep the stop state alive until the
+    // request completes.
+    std::stop_source source = self->stop_source_;
+    source.request_stop();
+  }
+
+  std::stop_source stop_source_;
+};
 } // namespace detail
 
 void suspend_token::notify() { stop_source_.request_stop(); }
 
-void suspend(suspend_token& token) {
+void suspend(suspend_token& token) { suspend(global_thread_pool(), token); }
+
+void suspend(thread_pool& pool, suspend_token& token) {
   concore2full::profiling::zone zone{CURRENT_LOCATION()};
   if (token.stop_source_.stop_requested())
     return;
-  global_thread_pool().offer_help_until(token.stop_source_.get_token());
+  pool.offer_help_until(token.stop_source_.get_token());
 }
 
 void suspend_quick_resume(suspend_token& token) {
+  suspend_quick_resume(global_thread_pool(), token);
+}
+
+void suspend_quick_resume(thread_pool& pool, suspend_token& token) {
   concore2full::profiling::zone zone{CURRENT_LOCATION()};
   auto stop_token = token.stop_source_.get_token();
-  (void)detail::callcc([stop_token](
+  (void)detail::callcc([&pool, stop_token](
                            detail::continuation_t after_suspend) -> detail::continuation_t {
     // If we are already stopped, return immediately.
     if (stop_token.stop_requested())
@@ -49,17 +70,17 @@ void suspend_quick_resume(suspend_token& token) {
     std::atomic<int> task_state{initial_state};
 
     // Register a stop callback that will spawn a new task to jump to the point after suspend.
-    std::stop_callback cb{stop_token, [&task, &task_state]() {
+    std::stop_callback cb{stop_token, [&pool, &task, &task_state]() {
                             int expected = initial_state;
                             if (task_state.compare_exchange_strong(expected, task_enqueuing,
                                                                    std::memory_order_release,
                                                                    std::memory_order_acquire)) {
-                              concore2full::global_thread_pool().enqueue(&task);
+                              pool.enqueue(&task);
                               task_state.store(task_enqueued, std::memory_order_release);
                             }
                           }};
 
-    global_thread_pool().offer_help_until(stop_token);
+    pool.offer_help_until(stop_token);
 
     // Did the callback got a chance to run?
     int expected = initial_state;
@@ -71,7 +92,7 @@ void suspend_quick_resume(suspend_token& token) {
     // When we wake up, try to steal the task.
     // First, wait for the task to be enqueued.
     concore2full::detail::atomic_wait(task_state, [](int s) { return s == task_enqueued; });
-    if (concore2full::global_thread_pool().extract_task(&task)) {
+    if (pool.extract_task(&task)) {
       // All good; we can just return in the same stack.
       return after_suspend;
     } else {
@@ -84,4 +105,26 @@ void suspend_quick_resume(suspend_token& token) {
   });
 }
 
-} // namespace concore2full
\ No newline at end of file
+void sleep_for(std::chrono::steady_clock::duration duration) {
+  sleep_for(global_thread_pool(), duration);
+}
+
+void sleep_for(thread_pool& pool, std::chrono::steady_clock::duration duration) {
+  sleep_until(pool, std::chrono::steady_clock::now() + duration);
+}
+
+void sleep_until(std::chrono::steady_clock::time_point deadline) {
+  sleep_until(global_thread_pool(), deadline);
+}
+
+void sleep_until(thread_pool& pool, std::chrono::steady_clock::time_point deadline) {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  if (std::chrono::steady_clock::now() >= deadline)
+    return;
+  detail::sleep_timer_task task;
+  auto stop_token = task.stop_source_.get_token();
+  pool.enqueue_at(deadline, &task);
+  pool.offer_help_until(stop_token);
+}
+
+} // namespace concore2full
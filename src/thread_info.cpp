@@ -5,8 +5,16 @@
 
 #include <cassert>
 #include <mutex>
+#include <thread>
 #include <vector>
 
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
 namespace concore2full::detail {
 
 namespace {
@@ -285,15 +293,78 @@ uint32_t prepare_sleep(thread_info& thread) {
   // Sync: treat this sleep as an acquire barrier, to help with synchronization in the outside code.
 }
 
+#ifdef __linux__
+// We use futexes directly, instead of `std::atomic::wait()`, as we also need to wait with a
+// timeout. Sleeping and waking up need to use the same mechanism.
+namespace {
+
+//! Waits while `counter` holds `expected`, for at most `timeout` (if not null). May wake up
+//! spuriously.
+void futex_wait(std::atomic<uint32_t>& counter, uint32_t expected, const timespec* timeout) {
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+  (void)::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&counter), FUTEX_WAIT_PRIVATE, expected,
+                  timeout, nullptr, 0);
+}
+
+//! Wakes up one thread waiting on `counter`.
+void futex_wake_one(std::atomic<uint32_t>& counter) {
+  (void)::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&counter), FUTEX_WAKE_PRIVATE, 1, nullptr,
+                  nullptr, 0);
+}
+
+} // namespace
+
+void sleep(thread_info& thread, uint32_t sleep_id) {
+  while (thread.sleeping_counter_.load(std::memory_order_acquire) == sleep_id)
+    futex_wait(thread.sleeping_counter_, sleep_id, nullptr);
+  // Sync: treat this sleep as an acquire barrier.
+}
+
+bool sleep_until(thread_info& thread, uint32_t sleep_id,
+                 std::chrono::steady_clock::time_point deadline) {
+  while (thread.sleeping_counter_.load(std::memory_order_acquire) == sleep_id) {
+    // Sync: treat this sleep as an acquire barrier.
+    auto remaining = deadline - std::chrono::steady_clock::now();
+    if (remaining <= std::chrono::steady_clock::duration::zero())
+      return false;
+    auto secs = std::chrono::duration_cast<std::chrono::seconds>(remaining);
+    auto nsecs = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining - secs);
+    timespec timeout{static_cast<time_t>(secs.count()), static_cast<long>(nsecs.count())};
+    futex_wait(thread.sleeping_counter_, sleep_id, &timeout);
+  }
+  return true;
+}
+
+void wake_up(thread_info& thread) {
+  thread.sleeping_counter_.fetch_add(1, std::memory_order_release);
+  futex_wake_one(thread.sleeping_counter_);
+  // Sync: treat this wake-up as a release barrier.
+}
+#else
 void sleep(thread_info& thread, uint32_t sleep_id) {
   thread.sleeping_counter_.wait(sleep_id, std::memory_order_acquire);
   // Sync: treat this sleep as an acquire barrier.
 }
 
+bool sleep_until(thread_info& thread, uint32_t sleep_id,
+                 std::chrono::steady_clock::time_point deadline) {
+  // Without a timed wait on atomics, poll the counter, sleeping for short intervals.
+  constexpr auto max_interval = std::chrono::microseconds{100};
+  while (thread.sleeping_counter_.load(std::memory_order_acquire) == sleep_id) {
+    // Sync: treat this sleep as an acquire barrier.
+    auto now = std::chrono::steady_clock::now();
+    if (now >= deadline)
+      return false;
+    std::this_thread::sleep_until(std::min(deadline, now + max_interval));
+  }
+  return true;
+}
+
 void wake_up(thread_info& thread) {
   thread.sleeping_counter_.fetch_add(1, std::memory_order_release);
   thread.sleeping_counter_.notify_one();
   // Sync: treat this wake-up as a release barrier.
 }
+#endif
 
 } // namespace concore2full::detail
\ No newline at end of file
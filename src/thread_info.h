@@ -3,6 +3,7 @@
 #include "concore2full/detail/catomic.h"
 #include "concore2full/detail/core_types.h"
 
+#include <chrono>
 #include <semaphore>
 
 namespace concore2full::detail {
@@ -54,6 +55,11 @@ uint32_t prepare_sleep(thread_info& thread);
 //! Puts `thread` to sleep until it is woken up.
 void sleep(thread_info& thread, uint32_t sleep_id);
 
+//! Puts `thread` to sleep until it is woken up, or until `deadline` is reached.
+//! Returns `true` if the thread was woken up, and `false` on timeout.
+bool sleep_until(thread_info& thread, uint32_t sleep_id,
+                 std::chrono::steady_clock::time_point deadline);
+
 //! Wakes up `thread`.
 void wake_up(thread_info& thread);
 
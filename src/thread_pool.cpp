@@ -1,33 +1,77 @@
 #include "concore2full/thread_pool.h"
+#include "concore2full/detail/cpu_topology.h"
 #include "concore2full/detail/sleep_helper.h"
+#include "concore2full/global_thread_pool.h"
 #include "concore2full/profiling.h"
+#include "concore2full/stack/pooled_stack_allocator.h"
 #include "concore2full/this_thread.h"
 #include "concore2full/thread_snapshot.h"
 #include "thread_info.h"
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <chrono>
+#include <cstddef>
+#include <functional>
+#include <latch>
+#include <memory>
+
+#include <unistd.h>
 
 using namespace std::chrono_literals;
 
 namespace concore2full {
 
-#ifndef NDEBUG
 namespace {
-//! Checks that the list represented by `head` is consistent.
-bool check_list(concore2full_task* head, void* data) {
+//! Returns an atomic view of the `worker_data_` field of `task`, which holds its claim state.
+std::atomic_ref<void*> claim_state(concore2full_task* task) {
+  return std::atomic_ref<void*>{task->worker_data_};
+}
+
+#ifndef NDEBUG
+//! Checks that the list represented by `head` is consistent, and that it ends with `tail`.
+//! Tasks in the list are either unclaimed (`worker_data_ == data`), or claimed by an extractor.
+bool check_list(concore2full_task* head, void* data, concore2full_task* tail) {
   concore2full_task* cur = head;
+  concore2full_task* last = nullptr;
   while (cur) {
     assert(cur->prev_link_);
     assert(*cur->prev_link_ == cur);
-    assert(cur->worker_data_ == data);
+    void* d = claim_state(cur).load(std::memory_order_relaxed);
+    assert(d == data || d == nullptr);
+    last = cur;
     cur = cur->next_;
   }
+  assert(last == tail);
   return true;
 }
-} // namespace
 #endif
+} // namespace
 
 namespace {
+
+//! Identifies the worker thread (or helper thread) that we are running on.
+struct worker_identity {
+  //! The thread pool that the worker belongs to; null if not running on a worker.
+  const thread_pool* pool_{nullptr};
+  //! The index of the worker in the thread pool; -1 for threads that offer help to the pool.
+  int index_{-1};
+  //! The index of the work line to which the thread pushes tasks.
+  int line_index_{-1};
+  //! The ID of the thread; used to double-check that we are reading the right thread-local data.
+  std::thread::id thread_id_{};
+};
+
+//! The identity of the current worker thread.
+thread_local worker_identity tls_worker;
+
+//! The number of times the current thread checked if a pool is full; used to recount the pending
+//! tasks from time to time.
+thread_local uint32_t tls_capacity_checks{0};
+//! The number of times the current thread removed tasks from a pool while producers were waiting.
+thread_local uint32_t tls_removals_with_waiters{0};
+
 //! Return the desired level of concurrency.
 size_t concurrency() {
   // Check if we have a maximum concurrency set as environment variable.
@@ -39,43 +83,232 @@ size_t concurrency() {
   // Otherwise, return the hardware concurrency.
   return std::thread::hardware_concurrency();
 }
+
+//! Returns the number of worker threads to start for a pool created with `cfg`.
+int initial_thread_count(const thread_pool::config& cfg) {
+  return cfg.num_threads >= 0 ? cfg.num_threads : static_cast<int>(concurrency());
+}
+
+//! Returns the maximum number of worker threads for a pool created with `cfg`.
+int max_thread_count(const thread_pool::config& cfg) {
+  return std::max(initial_thread_count(cfg), cfg.max_threads);
+}
+
+//! Allocates `count` stacks from the default stack pool, touches the top `prefault_size` bytes of
+//! each of them, and returns them to the pool; they will end up in the cache of this thread. The
+//! count is clamped to the size of the cache, so that no prewarmed stack is spilled.
+void prewarm_stacks(int count, std::size_t prefault_size) {
+  if (count <= 0)
+    return;
+  profiling::zone zone{CURRENT_LOCATION()};
+  auto& pool = stack::default_stack_pool();
+  count = static_cast<int>(std::min(static_cast<std::size_t>(count), pool.high_watermark()));
+  const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  std::vector<stack::stack_t> stacks;
+  stacks.reserve(count);
+  for (int i = 0; i < count; i++) {
+    stack::stack_t s = pool.allocate();
+    std::size_t size = std::min(prefault_size, s.size);
+    auto* top = static_cast<volatile char*>(s.sp);
+    for (std::size_t offset = page; offset <= size; offset += page)
+      top[-static_cast<std::ptrdiff_t>(offset)] = 0;
+    stacks.push_back(s);
+  }
+  for (auto s : stacks)
+    pool.deallocate(s);
+}
+
+//! Tells the CPU that we are in a spin loop.
+inline void cpu_relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield");
+#endif
+}
+
+/**
+ * @brief Decides how long an idle thread spins before going to sleep.
+ *
+ * Keeps a moving average of how long the thread waited for new tasks. If the thread typically gets
+ * new tasks within the maximum spin duration, it spins for about twice the average wait; otherwise,
+ * going to sleep is likely, and the thread only spins briefly, to catch bursts of tasks.
+ */
+class spin_policy {
+public:
+  explicit spin_policy(std::chrono::nanoseconds max_spin)
+      : max_spin_ns_(max_spin.count()), average_wait_ns_(max_spin_ns_ / 2) {}
+
+  //! Returns the time to spin before going to sleep.
+  std::chrono::nanoseconds budget() const noexcept {
+    if (max_spin_ns_ <= 0)
+      return std::chrono::nanoseconds{0};
+    if (average_wait_ns_ > max_spin_ns_)
+      return std::chrono::nanoseconds{max_spin_ns_ / 16};
+    return std::chrono::nanoseconds{std::min(max_spin_ns_, 2 * average_wait_ns_ + min_spin_ns)};
+  }
+
+  //! Records that the thread waited `wait` for new tasks.
+  void record_wait(std::chrono::nanoseconds wait) noexcept {
+    // Clamp long waits, so that we can quickly adapt when tasks start to come in faster.
+    int64_t wait_ns = std::min<int64_t>(wait.count(), 4 * max_spin_ns_);
+    average_wait_ns_ += (wait_ns - average_wait_ns_) / 8;
+  }
+
+private:
+  //! The minimum spinning time, when spinning is enabled.
+  static constexpr int64_t min_spin_ns = 1000;
+  //! The maximum time to spin.
+  int64_t max_spin_ns_;
+  //! Moving average of the time the thread waited for new tasks.
+  int64_t average_wait_ns_;
+};
 } // namespace
 
-thread_pool::thread_pool() : thread_pool(concurrency()) {}
+#if CONCORE2FULL_SCHEDULER_STATS
+//! Increments the given counter for the current thread, in the scheduling statistics.
+#define CONCORE2FULL_COUNT(counter)                                                                \
+  current_counters().counter.fetch_add(1, std::memory_order_relaxed)
+#else
+#define CONCORE2FULL_COUNT(counter) (void)0
+#endif
+
+thread_pool::thread_pool() : thread_pool(config{}) {}
+
+thread_pool::thread_pool(int thread_count) : thread_pool(config{.num_threads = thread_count}) {}
 
-thread_pool::thread_pool(int thread_count) : work_lines_(thread_count + 1) {
+thread_pool::thread_pool(const config& cfg)
+    : starvation_limit_(cfg.starvation_limit), order_(cfg.order),
+      num_tasks_(max_thread_count(cfg) + 1),
+      max_pending_tasks_(std::max(cfg.max_pending_tasks, 0)), on_overflow_(cfg.on_overflow),
+      pending_check_interval_(std::clamp<int64_t>(max_pending_tasks_ / 16, 1, 64)),
+      max_spin_duration_(cfg.max_spin_duration), config_(cfg) {
   profiling::zone zone{CURRENT_LOCATION()};
-  zone.set_param("thread_count", static_cast<int64_t>(thread_count));
+  // Spinning only steals time from the other threads if we have a single core.
+  if (std::thread::hardware_concurrency() <= 1)
+    max_spin_duration_ = std::chrono::nanoseconds{0};
+  timers_.epoch_ = std::chrono::steady_clock::now();
+  timers_.resolution_ = std::max(cfg.timer_resolution, std::chrono::nanoseconds{1});
+  // Size everything for the maximum number of threads, but start only `initial_count` threads.
+  int initial_count = initial_thread_count(cfg);
+  int thread_count = max_thread_count(cfg);
+  work_lines_ = std::vector<work_line>(thread_count + 1);
+  high_priority_.lines_ = std::vector<work_line>(work_lines_.size());
+  low_priority_.lines_ = std::vector<work_line>(work_lines_.size());
+  if (cfg.use_work_stealing_deques) {
+    deques_.reserve(thread_count);
+    for (int i = 0; i < thread_count; i++)
+      deques_.push_back(std::make_unique<detail::work_stealing_deque>(cfg.deque_capacity));
+  }
+  zone.set_param("thread_count", static_cast<int64_t>(initial_count));
+  zone.set_param("max_threads", static_cast<int64_t>(thread_count));
   // Create the sleep objects.
   int num_sleep_objects = thread_count + std::max(4, thread_count);
   sleep_objects_.resize(num_sleep_objects);
+  idle_bitmap_ = std::vector<std::atomic<uint64_t>>((num_sleep_objects + 63) / 64);
+  for (int i = 0; i < num_sleep_objects; i++)
+    sleep_objects_[i].set_idle_bit(i, &idle_bitmap_[i / 64], uint64_t(1) << (i % 64));
 
   // Free sleep objects (all the ones above the thread count).
-  free_sleep_objects_.reserve(thread_count);
-  for (int i = 0; i < thread_count; i++) {
-    free_sleep_objects_.push_back(thread_count + i);
+  free_sleep_objects_.reserve(num_sleep_objects - thread_count);
+  for (int i = thread_count; i < num_sleep_objects; i++) {
+    free_sleep_objects_.push_back(i);
+  }
+
+  // If needed, choose the CPUs for the workers, and the order in which they steal from each other.
+  worker_cpus_.assign(thread_count, -1);
+  if (cfg.pin_worker_threads) {
+    auto cpus = detail::read_cpu_topology();
+    if (!cpus.empty()) {
+      std::vector<detail::cpu_info> assigned;
+      assigned.reserve(thread_count);
+      for (int i = 0; i < thread_count; i++) {
+        assigned.push_back(cpus[i % cpus.size()]);
+        worker_cpus_[i] = assigned.back().cpu_;
+      }
+      steal_orders_.reserve(thread_count);
+      for (int i = 0; i < thread_count; i++)
+        steal_orders_.push_back(detail::topology_steal_order(assigned, i));
+    }
   }
 
   // Start the threads.
+  // Each thread prewarms its stacks before starting to execute work; we wait for all of them.
+  // The latch is shared, as the threads may still use it after we stop waiting.
+  auto prewarmed = std::make_shared<std::latch>(initial_count);
+#if CONCORE2FULL_SCHEDULER_STATS
+  counters_ = std::make_unique<thread_counters[]>(thread_count + 1);
+#endif
+  active_workers_.store(initial_count, std::memory_order_relaxed);
   threads_.reserve(thread_count);
   try {
-    for (int i = 0; i < thread_count; i++) {
-      threads_.emplace_back([this, i] { thread_main(i); });
-    }
+    for (int i = 0; i < initial_count; i++)
+      start_worker(i, prewarmed);
   } catch (...) {
+    prewarmed->count_down(initial_count - static_cast<int>(threads_.size()));
+    prewarmed->wait();
     join();
   }
-  profiling::define_counter_track(num_tasks_, "num_tasks");
+  prewarmed->wait();
 }
 thread_pool::~thread_pool() {
   profiling::zone zone{CURRENT_LOCATION()};
-  if (num_tasks_.load(std::memory_order_relaxed) > 0) {
-    // Users shall drain the tasks before destroying the thread pool.
+  if (num_tasks_.load(std::memory_order_relaxed) > 0 ||
+      timers_.next_expiration_.load(std::memory_order_relaxed) != timer_queue::none) {
+    // Users shall drain the tasks (including the timers) before destroying the thread pool.
     std::terminate();
   }
   join();
 }
 
+void thread_pool::start_worker(int index, std::shared_ptr<std::latch> prewarmed) {
+  assert(index == static_cast<int>(threads_.size()));
+  threads_.emplace_back([this, index, prewarmed = std::move(prewarmed), cpu = worker_cpus_[index]] {
+    if (cpu >= 0)
+      (void)detail::pin_current_thread_to_cpu(cpu);
+    prewarm_stacks(config_.prewarmed_stacks_per_worker, config_.prefault_size);
+    prewarmed->count_down();
+    thread_main(index);
+  });
+}
+
+int thread_pool::set_parallelism(int num_threads) noexcept {
+  profiling::zone zone{CURRENT_LOCATION()};
+  zone.set_param("num_threads", static_cast<int64_t>(num_threads));
+  std::unique_lock lock{threads_bottleneck_};
+  if (global_shutdown_.stop_requested() || max_parallelism() == 0)
+    return active_workers_.load(std::memory_order_relaxed);
+  num_threads = std::clamp(num_threads, 1, max_parallelism());
+  int old_count = active_workers_.load(std::memory_order_relaxed);
+
+  // Start the threads that were never started; stop growing if we cannot create more threads.
+  int started = threads_.size();
+  if (num_threads > started) {
+    auto prewarmed = std::make_shared<std::latch>(num_threads - started);
+    try {
+      for (int i = started; i < num_threads; i++)
+        start_worker(i, prewarmed);
+    } catch (...) {
+      prewarmed->count_down(num_threads - static_cast<int>(threads_.size()));
+      num_threads = std::max(static_cast<int>(threads_.size()), 1);
+    }
+    prewarmed->wait();
+  }
+
+  active_workers_.store(num_threads, std::memory_order_seq_cst);
+  // Sync: seq_cst: workers check `active_workers_` before parking; pairs with the wakeups below.
+  if (num_threads > old_count) {
+    // Wake up the parked workers. If they are not parked yet, they will not park anymore.
+    for (int i = old_count; i < num_threads; i++)
+      (void)sleep_objects_[i].try_notify(i);
+  } else {
+    // Wake up the retired workers that are sleeping, so that they park instead.
+    for (int i = num_threads; i < old_count; i++)
+      (void)wake_idle_thread(i, i);
+  }
+  return num_threads;
+}
+
 void thread_pool::enqueue(concore2full_task* task) noexcept {
   profiling::zone zone{CURRENT_LOCATION()};
   zone.set_param("task,x", reinterpret_cast<uint64_t>(task));
@@ -84,34 +317,318 @@ void thread_pool::enqueue(concore2full_task* task) noexcept {
   task->next_ = nullptr;
   task->prev_link_ = nullptr;
 
+  // If we are on a worker thread, push the task to the deque of the worker.
+  if (!deques_.empty()) {
+    int worker_index = current_worker_index();
+    if (worker_index >= 0 && worker_index < active_workers_.load(std::memory_order_relaxed) &&
+        deques_[worker_index]->try_push(task)) {
+      notify_one(worker_index);
+      return;
+    }
+  }
+
+  uint32_t index = push_to_lines(work_lines_, line_to_push_to(), task);
+  notify_one(index);
+}
+
+void thread_pool::enqueue(concore2full_task* task, task_priority priority) noexcept {
+  if (priority == task_priority::normal) {
+    enqueue(task);
+    return;
+  }
+  profiling::zone zone{CURRENT_LOCATION()};
+  zone.set_param("task,x", reinterpret_cast<uint64_t>(task));
+  zone.set_param("priority", static_cast<int64_t>(priority));
+  zone.add_flow(reinterpret_cast<uint64_t>(task));
+
+  task->next_ = nullptr;
+  task->prev_link_ = nullptr;
+
+  priority_lines& lines = priority == task_priority::high ? high_priority_ : low_priority_;
+  lines.num_tasks_.fetch_add(1, std::memory_order_relaxed);
+  // Sync: no ordering guarantees needed here; `notify_one` publishes the task.
+  uint32_t index = push_to_lines(lines.lines_, line_to_push_to(), task);
+  notify_one(index);
+}
+
+bool thread_pool::try_enqueue(concore2full_task* task) noexcept {
+  if (is_full())
+    return false;
+  enqueue(task);
+  return true;
+}
+
+bool thread_pool::enqueue_bounded(concore2full_task* task) noexcept {
+  if (!is_full()) {
+    enqueue(task);
+    return true;
+  }
+  profiling::zone zone{CURRENT_LOCATION()};
+  zone.set_param("task,x", reinterpret_cast<uint64_t>(task));
+  switch (on_overflow_) {
+  case overflow_policy::reject:
+    return false;
+  case overflow_policy::caller_runs: {
+    // Threads outside of the pool run the task as if it came from the extra line.
+    int own_line = current_line_index();
+    task->task_function_(task, own_line >= 0 ? own_line : static_cast<int>(work_lines_.size()) - 1);
+    return true;
+  }
+  case overflow_policy::suspend_producer:
+    wait_for_room();
+    enqueue(task);
+    return true;
+  }
+  return false;
+}
+
+bool thread_pool::is_full() noexcept {
+  if (max_pending_tasks_ == 0)
+    return false;
+  // Far from the limit, a thread cannot fill the pool between two recounts on its own.
+  int64_t summary = pending_summary_.load(std::memory_order_relaxed);
+  if (summary + pending_check_interval_ < max_pending_tasks_ &&
+      ++tls_capacity_checks % pending_check_interval_ != 0)
+    return false;
+  return is_full_now();
+}
+
+bool thread_pool::is_full_now() noexcept {
+  if (max_pending_tasks_ == 0)
+    return false;
+  int64_t pending = num_tasks_.load(std::memory_order_seq_cst);
+  pending_summary_.store(pending, std::memory_order_relaxed);
+  return pending >= max_pending_tasks_;
+}
+
+void thread_pool::wait_for_room() noexcept {
+  profiling::zone zone{CURRENT_LOCATION()};
+  while (is_full_now()) {
+    waiting_producer self;
+    {
+      std::unique_lock lock{producers_bottleneck_};
+      if (producers_tail_)
+        producers_tail_->next_ = &self;
+      else
+        producers_head_ = &self;
+      producers_tail_ = &self;
+      num_waiting_producers_.fetch_add(1, std::memory_order_seq_cst);
+    }
+    // Sync: seq_cst: pairs with the fence in `wake_waiting_producer()`; either we see the room
+    // that was freed, or the thread that freed it sees us (at the latest, when the pool drains).
+    if (is_full_now()) {
+      // Only `wake_waiting_producer()` stops the source, after removing us from the list.
+      offer_help_until(self.wakeup_.get_token());
+      continue;
+    }
+    // There is room already; leave the list, unless somebody already woke us up.
+    std::unique_lock lock{producers_bottleneck_};
+    waiting_producer* prev = nullptr;
+    for (auto* cur = producers_head_; cur; prev = cur, cur = cur->next_) {
+      if (cur != &self)
+        continue;
+      if (prev)
+        prev->next_ = self.next_;
+      else
+        producers_head_ = self.next_;
+      if (producers_tail_ == &self)
+        producers_tail_ = prev;
+      num_waiting_producers_.fetch_sub(1, std::memory_order_relaxed);
+      break;
+    }
+  }
+}
+
+void thread_pool::wake_waiting_producer(bool pool_drained) noexcept {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  // Sync: seq_cst: pairs with the producers registering, then checking if the pool is full.
+  if (num_waiting_producers_.load(std::memory_order_relaxed) == 0)
+    return;
+  // Recounting after every task is too expensive; draining the pool guarantees the wakeup.
+  if (!pool_drained && ++tls_removals_with_waiters % pending_check_interval_ != 0)
+    return;
+  if (is_full_now())
+    return;
+  std::stop_source to_wake;
+  {
+    std::unique_lock lock{producers_bottleneck_};
+    waiting_producer* w = producers_head_;
+    if (!w)
+      return;
+    producers_head_ = w->next_;
+    if (!producers_head_)
+      producers_tail_ = nullptr;
+    num_waiting_producers_.fetch_sub(1, std::memory_order_relaxed);
+    // Once woken up, the producer may go away; keep the stop state alive while stopping.
+    to_wake = w->wakeup_;
+  }
+  to_wake.request_stop();
+}
+
+void thread_pool::enqueue_after(std::chrono::steady_clock::duration delay,
+                                concore2full_task* task) noexcept {
+  enqueue_at(std::chrono::steady_clock::now() + delay, task);
+}
+
+void thread_pool::enqueue_at(std::chrono::steady_clock::time_point deadline,
+                             concore2full_task* task) noexcept {
+  profiling::zone zone{CURRENT_LOCATION()};
+  zone.set_param("task,x", reinterpret_cast<uint64_t>(task));
+  zone.add_flow(reinterpret_cast<uint64_t>(task));
+
+  task->next_ = nullptr;
+  task->prev_link_ = nullptr;
+
+  bool is_earliest = false;
+  {
+    std::unique_lock lock{timers_.bottleneck_};
+    if (!timers_.wheel_.insert(task, timers_.tick_not_before(deadline))) {
+      // The deadline already passed.
+      lock.unlock();
+      enqueue(task);
+      return;
+    }
+    int64_t next = timers_.time_of(timers_.wheel_.next_expiration());
+    if (next < timers_.next_expiration_.load(std::memory_order_relaxed)) {
+      timers_.next_expiration_.store(next, std::memory_order_seq_cst);
+      is_earliest = true;
+    }
+  }
+  // Sync: seq_cst: pairs with the sleeping threads setting their idle bits, then reading the
+  // expiration time and the keeper.
+
+  // Make sure an idle thread waits for the new expiration time: either the current keeper, which
+  // may sleep until a later time, or any idle thread, if there is no keeper.
+  if (!is_earliest)
+    return;
+  int keeper = timers_.keeper_.load(std::memory_order_seq_cst);
+  if (keeper >= 0)
+    (void)wake_idle_thread(keeper, 0);
+  else
+    (void)wake_idle_threads(1, 0);
+}
+
+void thread_pool::enqueue_on(int worker_index, concore2full_task* task) noexcept {
+  profiling::zone zone{CURRENT_LOCATION()};
+  zone.set_param("task,x", reinterpret_cast<uint64_t>(task));
+  zone.set_param("worker_index", static_cast<int64_t>(worker_index));
+  zone.add_flow(reinterpret_cast<uint64_t>(task));
+  assert(worker_index >= 0);
+
+  task->next_ = nullptr;
+  task->prev_link_ = nullptr;
+
+  // The line of a worker has the same index as the worker. Without workers, use the extra line.
+  int thread_count = available_parallelism();
+  int index = thread_count > 0 ? worker_index % thread_count
+                               : static_cast<int>(work_lines_.size()) - 1;
+  work_lines_[index].push(task);
+
+  num_tasks_.add(counter_shard(), 1, std::memory_order_seq_cst);
+  // Sync: seq_cst: pairs with the sleeping threads setting their idle bits.
+  // Prefer waking up the target worker; if it's not sleeping, notify as usual.
+  if (!wake_idle_thread(index, index) && num_spinning_.load(std::memory_order_seq_cst) == 0)
+    (void)wake_idle_threads(1, index);
+}
+
+void thread_pool::enqueue_on_workers_impl(concore2full_task* first, std::size_t stride,
+                                          int count) noexcept {
+  profiling::zone zone{CURRENT_LOCATION()};
+  zone.set_param("count", static_cast<int64_t>(count));
+
+  // Task `i` goes to the line of worker `i % thread_count`.
+  int thread_count = available_parallelism();
+  if (thread_count == 0) {
+    enqueue_bulk_impl(first, stride, count);
+    return;
+  }
+  int num_lines = std::min(count, thread_count);
+  auto* cur = reinterpret_cast<char*>(first);
+  for (int w = 0; w < num_lines; w++) {
+    int line_count = count / thread_count + (w < count % thread_count ? 1 : 0);
+    work_lines_[w].push_bulk(reinterpret_cast<concore2full_task*>(cur + w * stride),
+                             stride * thread_count, line_count);
+  }
+
+  num_tasks_.add(counter_shard(), count, std::memory_order_seq_cst);
+  // Sync: seq_cst: pairs with the sleeping threads setting their idle bits.
+  for (int w = 0; w < num_lines; w++)
+    (void)wake_idle_thread(w, w);
+}
+
+uint32_t thread_pool::line_to_push_to() noexcept {
   // Note: using uint32_t, as we need to safely wrap around.
   uint32_t work_line_count = work_lines_.size();
   assert(work_line_count > 0);
-  uint32_t index = line_to_push_to_.fetch_add(1, std::memory_order_relaxed) % work_line_count;
+  // Threads of this pool push to their own lines; for other threads, use round-robin.
+  int own_line = current_line_index();
+  return own_line >= 0
+             ? static_cast<uint32_t>(own_line)
+             : line_to_push_to_.fetch_add(1, std::memory_order_relaxed) % work_line_count;
+}
 
+uint32_t thread_pool::push_to_lines(std::vector<work_line>& lines, uint32_t index,
+                                    concore2full_task* task) noexcept {
+  uint32_t work_line_count = lines.size();
   // Try to push this to a worker thread without blocking.
   for (uint32_t i = 0; i < work_line_count; i++) {
     uint32_t current_index = (index + i) % work_line_count;
-    if (work_lines_[current_index].try_push(task)) {
-      notify_one(current_index);
-      return;
-    }
+    if (lines[current_index].try_push(task))
+      return current_index;
   }
   // If that didn't work, just force-push to the queue of the selected worker thread.
   uint32_t current_index = index % work_line_count;
-  work_lines_[current_index].push(task);
-  notify_one(current_index);
+  lines[current_index].push(task);
+  return current_index;
+}
+
+void thread_pool::enqueue_bulk_impl(concore2full_task* first, std::size_t stride,
+                                    int count) noexcept {
+  profiling::zone zone{CURRENT_LOCATION()};
+  zone.set_param("count", static_cast<int64_t>(count));
+
+  // Split the tasks in chunks, one for each line.
+  int work_line_count = work_lines_.size();
+  int num_chunks = std::min(count, work_line_count);
+  int own_line = current_line_index();
+  int first_line = own_line >= 0 ? own_line
+                                 : static_cast<int>(line_to_push_to_.fetch_add(
+                                                        num_chunks, std::memory_order_relaxed) %
+                                                    work_line_count);
+  auto* cur = reinterpret_cast<char*>(first);
+  for (int c = 0; c < num_chunks; c++) {
+    // Distribute the remainder over the first chunks.
+    int chunk_size = count / num_chunks + (c < count % num_chunks ? 1 : 0);
+    int line_index = (first_line + c) % work_line_count;
+    work_lines_[line_index].push_bulk(reinterpret_cast<concore2full_task*>(cur), stride,
+                                      chunk_size);
+    cur += chunk_size * stride;
+  }
+  notify_bulk(count, first_line, num_chunks);
 }
 
 bool thread_pool::extract_task(concore2full_task* task) noexcept {
   profiling::zone zone{CURRENT_LOCATION()};
   zone.set_param("task,x", reinterpret_cast<uint64_t>(task));
   zone.add_flow_terminate(reinterpret_cast<uint64_t>(task));
-  auto d = static_cast<work_line*>(task->worker_data_);
-  bool res = d ? d->extract_task(task) : false;
+  void* d = claim_state(task).load(std::memory_order_acquire);
+  bool res = false;
+  if (detail::work_stealing_deque::is_deque_data(d))
+    res = detail::work_stealing_deque::extract(task);
+  else if (d) {
+    auto* line = static_cast<work_line*>(d);
+    res = line->extract_task(task);
+    if (res && high_priority_.contains(line))
+      high_priority_.num_tasks_.fetch_sub(1, std::memory_order_relaxed);
+    else if (res && low_priority_.contains(line))
+      low_priority_.num_tasks_.fetch_sub(1, std::memory_order_relaxed);
+  }
   if (res) {
-    num_tasks_.fetch_sub(1, std::memory_order_release);
+    CONCORE2FULL_COUNT(tasks_extracted_);
+    num_tasks_.add(counter_shard(), -1, std::memory_order_release);
     // Sync: ensure that all the stores are published before this one
+    if (max_pending_tasks_ > 0)
+      wake_waiting_producer(false);
   }
   return res;
 }
@@ -143,10 +660,22 @@ void thread_pool::offer_help_until(std::stop_token stop_condition) noexcept {
   thread_sleep_data& sleep_object = sleep_objects_[sleep_object_index];
   std::stop_callback callback(stop_condition, [&sleep_object] { sleep_object.try_notify(0); });
 
-  // Run the loop to execute tasks.
+  // While helping, tasks enqueued from this thread go to the line we are working on.
+  // Worker threads of this pool keep their identity.
   int index_hint = sleep_object_index;
+  auto thread_id = std::this_thread::get_id();
+  worker_identity saved = tls_worker;
+  bool set_identity = current_line_index() < 0;
+  if (set_identity)
+    tls_worker = {this, -1, index_hint % static_cast<int>(work_lines_.size()), thread_id};
+
+  // Run the loop to execute tasks.
   execute_work(stop_condition, index_hint, sleep_object);
 
+  // Restore the identity, if we are still on the same thread.
+  if (set_identity && std::this_thread::get_id() == thread_id)
+    tls_worker = saved;
+
   // Return the sleep object
   {
     std::unique_lock lock{free_sleep_objects_bottleneck_};
@@ -163,11 +692,15 @@ void thread_pool::join() noexcept {
   for (auto& t : sleep_objects_) {
     t.try_notify(0);
   }
-  // Join the threads.
-  for (auto& t : threads_) {
+  // Join the threads. No new threads can be started after we stopped.
+  std::vector<std::thread> threads;
+  {
+    std::unique_lock lock{threads_bottleneck_};
+    threads.swap(threads_);
+  }
+  for (auto& t : threads) {
     t.join();
   }
-  threads_.clear();
 }
 
 bool thread_pool::thread_sleep_data::try_notify(int work_line_hint) noexcept {
@@ -188,20 +721,64 @@ bool thread_pool::thread_sleep_data::try_notify(int work_line_hint) noexcept {
   }
   return false;
 }
-int thread_pool::thread_sleep_data::sleep(std::stop_token stop_condition) noexcept {
+int thread_pool::thread_sleep_data::sleep(std::stop_token stop_condition,
+                                          detail::sharded_counter* pending_tasks,
+                                          timer_queue* timers) noexcept {
   profiling::zone zone{CURRENT_LOCATION()};
 
   detail::sleep_helper sleep_helper;
   wakeup_token_ = sleep_helper.get_wakeup_token();
+  int64_t wake_time = timer_queue::none;
+  if (pending_tasks && !idle_word_ && pending_tasks->recount() > 0) {
+    // Nobody can find us to wake us up; don't sleep while there are tasks.
+    return work_line_start_index_.load(std::memory_order_acquire);
+  }
+  if (idle_word_ && pending_tasks) {
+    // Announce that we are about to sleep, then check again for tasks. A notifier increments the
+    // number of tasks before looking at the bitmap, so either it sees our bit, or we see its task.
+    // We may miss a task if we see the decrement for another task whose increment we don't see;
+    // but the increment for that task comes after we set our bit, so its notifier will see it.
+    idle_word_->fetch_or(idle_bit_, std::memory_order_seq_cst);
+    // The recount also refreshes the summary that busy and spinning threads check.
+    if (pending_tasks->recount() > 0) {
+      idle_word_->fetch_and(~idle_bit_, std::memory_order_relaxed);
+      return work_line_start_index_.load(std::memory_order_acquire);
+    }
+    // The same goes for the timers: `enqueue_at()` publishes a new expiration time before looking
+    // at the keeper and at the bitmap. If nobody waits for the timers, we become the keeper.
+    if (timers)
+      wake_time = timers->next_expiration_.load(std::memory_order_seq_cst);
+    if (wake_time != timer_queue::none) {
+      int keeper = timers->keeper_.load(std::memory_order_seq_cst);
+      if (keeper < 0 && timers->keeper_.compare_exchange_strong(keeper, index_,
+                                                                 std::memory_order_seq_cst))
+        keeper = index_;
+      if (keeper != index_)
+        wake_time = timer_queue::none;
+      else if (wake_time <= std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now().time_since_epoch())
+                                .count()) {
+        idle_word_->fetch_and(~idle_bit_, std::memory_order_relaxed);
+        return work_line_start_index_.load(std::memory_order_acquire);
+      }
+    }
+  }
   if (wake_requests_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
     // Sync: acquire: don't move any sleep operations before this.
     // Sync: release: don't move the above `wakeup_token_` stores after this. A thread that is
     // trying to wake us up should have access to the wakeup token.
     if (!stop_condition.stop_requested()) {
       // Sync: no ordering guarantees needed here.
-      sleep_helper.sleep();
+      if (wake_time != timer_queue::none)
+        (void)sleep_helper.sleep_until(std::chrono::steady_clock::time_point{
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::nanoseconds{wake_time})});
+      else
+        sleep_helper.sleep();
     }
   }
+  if (idle_word_)
+    idle_word_->fetch_and(~idle_bit_, std::memory_order_relaxed);
   wake_requests_.store(1, std::memory_order_release);
   // Sync: don't any stores after this.
   return work_line_start_index_.load(std::memory_order_acquire);
@@ -222,74 +799,367 @@ void thread_pool::work_line::push(concore2full_task* task) noexcept {
   std::unique_lock lock{bottleneck_};
   push_unprotected(task);
 }
-concore2full_task* thread_pool::work_line::try_pop() noexcept {
+concore2full_task* thread_pool::work_line::try_pop(bool* contended, bool oldest) noexcept {
   std::unique_lock lock{bottleneck_, std::try_to_lock};
-  if (!lock || !tasks_stack_)
+  if (!lock) {
+    if (contended)
+      *contended = true;
     return nullptr;
-  return pop_unprotected();
+  }
+  if (!tasks_stack_)
+    return nullptr;
+  return pop_unprotected(oldest);
+}
+void thread_pool::work_line::push_bulk(concore2full_task* first, std::size_t stride,
+                                        int count) noexcept {
+  // Link the tasks together, without holding the lock.
+  // The tasks are not visible to other threads until we add them to the list.
+  auto at = [first, stride](int i) {
+    return reinterpret_cast<concore2full_task*>(reinterpret_cast<char*>(first) + i * stride);
+  };
+  for (int i = 0; i < count; i++) {
+    concore2full_task* task = at(i);
+    claim_state(task).store(this, std::memory_order_relaxed);
+    task->next_ = i + 1 < count ? at(i + 1) : nullptr;
+    if (i > 0)
+      task->prev_link_ = &at(i - 1)->next_;
+  }
+  concore2full_task* last = at(count - 1);
+
+  // Add the chain in the front of the list.
+  std::unique_lock lock{bottleneck_};
+  assert(check_list(tasks_stack_, this, tail_));
+  last->next_ = tasks_stack_;
+  if (tasks_stack_)
+    tasks_stack_->prev_link_ = &last->next_;
+  else
+    tail_ = last;
+  first->prev_link_ = &tasks_stack_;
+  tasks_stack_ = first;
+  assert(check_list(tasks_stack_, this, tail_));
 }
+
 bool thread_pool::work_line::extract_task(concore2full_task* task) noexcept {
   profiling::zone zone{CURRENT_LOCATION()};
   zone.set_param("line,x", this);
+  // Race with the threads popping tasks on the claim state; no need for the lock if we lose.
+  void* expected = this;
+  if (!claim_state(task).compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel,
+                                                 std::memory_order_relaxed))
+    return false;
+
+  // The task is ours. It may still be in the list, and the caller may free it as soon as we
+  // return, so we need to remove it, unless a popping thread already skipped over it.
   std::unique_lock lock{bottleneck_};
-  assert(check_list(tasks_stack_, this));
-  assert(!tasks_stack_ || tasks_stack_->prev_link_ == &tasks_stack_);
-  if (task->worker_data_) {
-    assert(task->worker_data_ == this);
-    assert(task->prev_link_);
+  assert(check_list(tasks_stack_, this, tail_));
+  if (task->prev_link_) {
     assert(*task->prev_link_ == task);
-
-    *task->prev_link_ = task->next_;
-    if (task->next_)
-      task->next_->prev_link_ = task->prev_link_;
-    task->worker_data_ = nullptr;
-    task->prev_link_ = nullptr;
-    assert(tasks_stack_ != task);
-    assert(!tasks_stack_ || tasks_stack_->prev_link_ == &tasks_stack_);
-    assert(check_list(tasks_stack_, this));
-    return true;
-  } else {
-    return false;
+    unlink_unprotected(task);
   }
+  assert(check_list(tasks_stack_, this, tail_));
+  return true;
 }
 
 void thread_pool::work_line::push_unprotected(concore2full_task* task) noexcept {
   // Add the task in the front of the list.
-  assert(check_list(tasks_stack_, this));
-  task->worker_data_ = this;
+  assert(check_list(tasks_stack_, this, tail_));
+  claim_state(task).store(this, std::memory_order_relaxed);
   task->next_ = tasks_stack_;
   if (tasks_stack_)
     tasks_stack_->prev_link_ = &task->next_;
+  else
+    tail_ = task;
   task->prev_link_ = &tasks_stack_;
   tasks_stack_ = task;
-  assert(check_list(tasks_stack_, this));
-}
-
-concore2full_task* thread_pool::work_line::pop_unprotected() noexcept {
-  assert(check_list(tasks_stack_, this));
-  if (tasks_stack_) {
-    concore2full_task* res = tasks_stack_;
-    tasks_stack_ = tasks_stack_->next_;
-    if (tasks_stack_)
-      tasks_stack_->prev_link_ = &tasks_stack_;
-    res->prev_link_ = nullptr;
-    res->worker_data_ = nullptr;
-    assert(check_list(tasks_stack_, this));
-    return res;
+  assert(check_list(tasks_stack_, this, tail_));
+}
+
+concore2full_task* thread_pool::work_line::pop_unprotected(bool oldest) noexcept {
+  assert(check_list(tasks_stack_, this, tail_));
+  while (tasks_stack_) {
+    concore2full_task* res = oldest ? tail_ : tasks_stack_;
+    unlink_unprotected(res);
+    // Claim the task; if an extractor claimed it first, just drop it from the list.
+    void* expected = this;
+    if (claim_state(res).compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel,
+                                                 std::memory_order_relaxed)) {
+      assert(check_list(tasks_stack_, this, tail_));
+      return res;
+    }
   }
   return nullptr;
 }
 
+void thread_pool::work_line::unlink_unprotected(concore2full_task* task) noexcept {
+  if (task == tail_) {
+    // The new tail is the task holding the `next_` field that points to `task`, if any.
+    tail_ = task->prev_link_ == &tasks_stack_
+                ? nullptr
+                : reinterpret_cast<concore2full_task*>(
+                      reinterpret_cast<char*>(task->prev_link_) -
+                      offsetof(concore2full_task, next_));
+  }
+  *task->prev_link_ = task->next_;
+  if (task->next_)
+    task->next_->prev_link_ = task->prev_link_;
+  task->prev_link_ = nullptr;
+}
+
 void thread_pool::notify_one(int work_line_hint) noexcept {
-  int old = num_tasks_.fetch_add(1, std::memory_order_relaxed);
-  // Sync: no ordering guarantees needed here.
-  if (old <= int(sleep_objects_.size())) {
-    for (auto& t : sleep_objects_) {
-      if (t.try_notify(work_line_hint)) {
-        return;
-      }
+  num_tasks_.add(counter_shard(), 1, std::memory_order_seq_cst);
+  // Sync: seq_cst: pairs with the sleeping threads setting their idle bits, and with the spinning
+  // threads decrementing `num_spinning_` before going to sleep.
+  // If a thread is spinning, it will pick up the task; no need to wake up a sleeping thread.
+  if (num_spinning_.load(std::memory_order_seq_cst) == 0)
+    (void)wake_idle_threads(1, work_line_hint);
+}
+
+uint64_t
+thread_pool::timer_queue::tick_not_before(std::chrono::steady_clock::time_point deadline) const
+    noexcept {
+  int64_t ns = std::chrono::ceil<std::chrono::nanoseconds>(deadline - epoch_).count();
+  return ns <= 0 ? 0 : static_cast<uint64_t>((ns + resolution_.count() - 1) / resolution_.count());
+}
+
+uint64_t
+thread_pool::timer_queue::tick_not_after(std::chrono::steady_clock::time_point now) const noexcept {
+  int64_t ns = std::chrono::floor<std::chrono::nanoseconds>(now - epoch_).count();
+  return ns <= 0 ? 0 : static_cast<uint64_t>(ns / resolution_.count());
+}
+
+int64_t thread_pool::timer_queue::time_of(uint64_t tick) const noexcept {
+  if (tick == detail::timer_wheel::no_expiration)
+    return none;
+  auto t = epoch_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        resolution_ * static_cast<int64_t>(tick));
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+void thread_pool::fire_expired_timers() noexcept {
+  // Most of the times, there are no timers, or the earliest one is not due yet.
+  int64_t next = timers_.next_expiration_.load(std::memory_order_relaxed);
+  if (next == timer_queue::none)
+    return;
+  auto now = std::chrono::steady_clock::now();
+  if (std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count() < next)
+    return;
+
+  concore2full_task* expired{nullptr};
+  {
+    std::unique_lock lock{timers_.bottleneck_, std::try_to_lock};
+    if (!lock)
+      return;
+    expired = timers_.wheel_.advance(timers_.tick_not_after(now));
+    timers_.next_expiration_.store(timers_.time_of(timers_.wheel_.next_expiration()),
+                                   std::memory_order_seq_cst);
+  }
+
+  profiling::zone zone{CURRENT_LOCATION()};
+  while (expired) {
+    concore2full_task* next_task = expired->next_;
+    enqueue(expired);
+    expired = next_task;
+  }
+}
+
+void thread_pool::release_timer_keeper(int sleep_index) noexcept {
+  // Only the keeper itself can change `keeper_` from its own index.
+  if (sleep_index < 0 || timers_.keeper_.load(std::memory_order_relaxed) != sleep_index)
+    return;
+  timers_.keeper_.store(-1, std::memory_order_seq_cst);
+  // Sync: seq_cst: pairs with the sleeping threads setting their idle bits, then reading the
+  // keeper.
+  if (timers_.next_expiration_.load(std::memory_order_seq_cst) != timer_queue::none)
+    (void)wake_idle_threads(1, 0);
+}
+
+bool thread_pool::wake_idle_thread(int index, int work_line_hint) noexcept {
+  auto& word = idle_bitmap_[index / 64];
+  uint64_t bit = uint64_t(1) << (index % 64);
+  if ((word.load(std::memory_order_seq_cst) & bit) == 0)
+    return false;
+  // Claim the bit; if somebody else cleared it in the meantime, the thread is not ours to wake.
+  if ((word.fetch_and(~bit, std::memory_order_acq_rel) & bit) == 0)
+    return false;
+  (void)sleep_objects_[index].try_notify(work_line_hint);
+  CONCORE2FULL_COUNT(wakeups_);
+  return true;
+}
+
+int thread_pool::wake_idle_threads(int max_count, int first_line) noexcept {
+  int work_line_count = work_lines_.size();
+  int woken = 0;
+  for (size_t w = 0; w < idle_bitmap_.size() && woken < max_count; w++) {
+    uint64_t bits = idle_bitmap_[w].load(std::memory_order_seq_cst);
+    while (bits != 0 && woken < max_count) {
+      uint64_t bit = bits & (~bits + 1);
+      bits &= ~bit;
+      // Claim the bit; if somebody else cleared it in the meantime, the thread is not ours to wake.
+      if ((idle_bitmap_[w].fetch_and(~bit, std::memory_order_acq_rel) & bit) == 0)
+        continue;
+      // The thread may not be fully asleep yet; in that case, it will not sleep anymore.
+      int index = static_cast<int>(w) * 64 + std::countr_zero(bit);
+      (void)sleep_objects_[index].try_notify((first_line + woken) % work_line_count);
+      CONCORE2FULL_COUNT(wakeups_);
+      woken++;
+    }
+  }
+  return woken;
+}
+
+bool thread_pool::spin_until_work(std::stop_token stop_condition,
+                                  std::chrono::nanoseconds budget) noexcept {
+  profiling::zone zone{CURRENT_LOCATION()};
+  num_spinning_.fetch_add(1, std::memory_order_seq_cst);
+  auto start = std::chrono::steady_clock::now();
+  bool has_work = false;
+  int pauses = 1;
+  while (!stop_condition.stop_requested()) {
+    if (num_tasks_.maybe_positive()) {
+      has_work = true;
+      break;
+    }
+    // Exponential backoff, to reduce the traffic on the summary of `num_tasks_`.
+    for (int i = 0; i < pauses; i++)
+      cpu_relax();
+    pauses = std::min(2 * pauses, 64);
+    if (std::chrono::steady_clock::now() - start >= budget)
+      break;
+  }
+  num_spinning_.fetch_sub(1, std::memory_order_seq_cst);
+  // Sync: seq_cst: if we go to sleep, we check `num_tasks_` after this.
+
+  // Notifiers may have skipped waking up threads because we were spinning; if there are more tasks
+  // than we can handle, wake up another thread. This needs the actual count, but it's summed once
+  // per spinning episode, not on every check.
+  if (has_work && num_tasks_.load(std::memory_order_relaxed) > 1)
+    (void)wake_idle_threads(1, 0);
+  return has_work;
+}
+
+thread_pool::thread_counters& thread_pool::current_counters() noexcept {
+  int worker_index = current_worker_index();
+  return counters_[worker_index >= 0 ? worker_index : static_cast<int>(work_lines_.size()) - 1];
+}
+
+bool thread_pool::takes_oldest_from(int index) const noexcept {
+  switch (order_) {
+  case queue_order::lifo:
+    return false;
+  case queue_order::fifo:
+    return true;
+  case queue_order::hybrid:
+    return index != current_line_index();
+  }
+  return false;
+}
+
+concore2full_task* thread_pool::try_pop_from(std::vector<work_line>& lines, int index) noexcept {
+  work_line& line = lines[index];
+  bool oldest = takes_oldest_from(index);
+#if CONCORE2FULL_SCHEDULER_STATS
+  bool contended = false;
+  concore2full_task* task = line.try_pop(&contended, oldest);
+  if (!task && contended)
+    CONCORE2FULL_COUNT(pops_contended_);
+  else if (!task)
+    CONCORE2FULL_COUNT(pops_empty_);
+  return task;
+#else
+  return line.try_pop(nullptr, oldest);
+#endif
+}
+
+thread_pool_stats thread_pool::worker_stats(int worker_index) const noexcept {
+  thread_pool_stats res{};
+  if (!counters_ || worker_index < 0 || worker_index >= static_cast<int>(work_lines_.size()))
+    return res;
+  const thread_counters& c = counters_[worker_index];
+  res.tasks_executed_ = c.tasks_executed_.load(std::memory_order_relaxed);
+  res.tasks_stolen_ = c.tasks_stolen_.load(std::memory_order_relaxed);
+  res.pops_contended_ = c.pops_contended_.load(std::memory_order_relaxed);
+  res.pops_empty_ = c.pops_empty_.load(std::memory_order_relaxed);
+  res.sleeps_ = c.sleeps_.load(std::memory_order_relaxed);
+  res.wakeups_ = c.wakeups_.load(std::memory_order_relaxed);
+  res.tasks_extracted_ = c.tasks_extracted_.load(std::memory_order_relaxed);
+  return res;
+}
+
+thread_pool_stats thread_pool::stats() const noexcept {
+  thread_pool_stats res{};
+  for (int i = 0; i < static_cast<int>(work_lines_.size()); i++) {
+    thread_pool_stats w = worker_stats(i);
+    res.tasks_executed_ += w.tasks_executed_;
+    res.tasks_stolen_ += w.tasks_stolen_;
+    res.pops_contended_ += w.pops_contended_;
+    res.pops_empty_ += w.pops_empty_;
+    res.sleeps_ += w.sleeps_;
+    res.wakeups_ += w.wakeups_;
+    res.tasks_extracted_ += w.tasks_extracted_;
+  }
+  return res;
+}
+
+thread_pool::spin_stats thread_pool::spin_statistics() const noexcept {
+  return {parks_avoided_.load(std::memory_order_relaxed), parks_.load(std::memory_order_relaxed)};
+}
+
+int thread_pool::current_worker_index() const noexcept {
+  const worker_identity& w = tls_worker;
+  // Coroutines can move between threads; ensure we are not reading the data of another thread.
+  if (w.pool_ == this && w.thread_id_ == std::this_thread::get_id())
+    return w.index_;
+  return -1;
+}
+
+int thread_pool::current_line_index() const noexcept {
+  const worker_identity& w = tls_worker;
+  if (w.pool_ == this && w.thread_id_ == std::this_thread::get_id())
+    return w.line_index_;
+  return -1;
+}
+
+int thread_pool::counter_shard() const noexcept {
+  // Threads of this pool use the shard of their own line; other threads are spread by their IDs.
+  int own_line = current_line_index();
+  if (own_line >= 0)
+    return own_line;
+  return static_cast<int>(std::hash<std::thread::id>{}(std::this_thread::get_id()) %
+                          static_cast<std::size_t>(num_tasks_.num_shards()));
+}
+
+const std::vector<int>* thread_pool::steal_order() const noexcept {
+  if (steal_orders_.empty())
+    return nullptr;
+  int worker_index = current_worker_index();
+  return worker_index >= 0 ? &steal_orders_[worker_index] : nullptr;
+}
+
+concore2full_task* thread_pool::steal_from_deques(int index_hint, int& index) noexcept {
+  if (const auto* order = steal_order()) {
+    for (int i : *order) {
+      index = i;
+      if (auto* task = deques_[index]->steal())
+        return task;
     }
+    return nullptr;
+  }
+  int count = deques_.size();
+  for (int i = 0; i < count; i++) {
+    index = (index_hint + i) % count;
+    if (auto* task = deques_[index]->steal())
+      return task;
   }
+  return nullptr;
+}
+
+void thread_pool::notify_bulk(int num_tasks, int first_line, int num_lines) noexcept {
+  num_tasks_.add(counter_shard(), num_tasks, std::memory_order_seq_cst);
+  // Sync: seq_cst: pairs with the sleeping threads setting their idle bits, and with the spinning
+  // threads decrementing `num_spinning_` before going to sleep.
+  int to_wake = num_lines - num_spinning_.load(std::memory_order_seq_cst);
+  if (to_wake > 0)
+    (void)wake_idle_threads(to_wake, first_line);
 }
 
 std::string thread_name(int index) { return "worker-" + std::to_string(index); }
@@ -299,54 +1169,190 @@ void thread_pool::thread_main(int thread_index) noexcept {
 
   auto* cur_thread = &detail::get_current_thread_info();
   profiling::zone_instant z0{CURRENT_LOCATION_N("worker thread start")};
-  z0.set_param("thread,x", &threads_[thread_index]);
+  z0.set_param("thread_index", static_cast<int64_t>(thread_index));
   z0.set_param("cur_thread,x", cur_thread);
 
   // We need to exit on the same thread.
   thread_snapshot t;
 
+  tls_worker = {this, thread_index, thread_index, std::this_thread::get_id()};
   execute_work(global_shutdown_.get_token(), thread_index, sleep_objects_[thread_index]);
 
   // Ensure we finish on the same thread
   t.revert();
+  tls_worker = {};
 
   (void)profiling::zone_instant{CURRENT_LOCATION_N("worker thread end")};
 }
 
+concore2full_task* thread_pool::pop_from(priority_lines& lines, int index_hint,
+                                        int& index) noexcept {
+  if (lines.num_tasks_.load(std::memory_order_relaxed) <= 0)
+    return nullptr;
+  int work_line_count = lines.lines_.size();
+  for (int i = 0; i < 2 * work_line_count; i++) {
+    index = (i + index_hint) % work_line_count;
+    if (auto* task = try_pop_from(lines.lines_, index)) {
+      lines.num_tasks_.fetch_sub(1, std::memory_order_relaxed);
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+concore2full_task* thread_pool::pop_normal_priority(int index_hint, int& index) noexcept {
+  concore2full_task* task{nullptr};
+
+  // If we are a worker thread, first look in our own deque.
+  // Note: we may be running on a different thread after executing tasks.
+  if (!deques_.empty()) {
+    index = current_worker_index();
+    // In FIFO mode, take the oldest task from our deque, the same way thieves do.
+    if (index >= 0)
+      task = order_ == queue_order::fifo ? deques_[index]->steal() : deques_[index]->pop();
+  }
+
+  // Then look in our own line; tasks may be enqueued for this particular thread.
+  if (!task) {
+    int own_line = current_line_index();
+    if (own_line >= 0) {
+      index = own_line;
+      task = try_pop_from(work_lines_, own_line);
+    }
+  }
+
+  // If the pool looks empty, don't poll the lines and deques of the other threads.
+  if (!task && !num_tasks_.maybe_positive())
+    return nullptr;
+
+  // Try to pop a task from the first thread data available.
+  // If we know the topology, visit the lines of the closest workers first, and the extra line last.
+  int work_line_count = work_lines_.size();
+  if (const auto* order = steal_order()) {
+    int order_size = order->size();
+    for (int i = 0; !task && i < 2 * (order_size + 1); i++) {
+      int pos = i % (order_size + 1);
+      index = pos < order_size ? (*order)[pos] : work_line_count - 1;
+      task = try_pop_from(work_lines_, index);
+    }
+  } else {
+    for (int i = 0; !task && i < 2 * work_line_count; i++) {
+      index = (i + index_hint) % work_line_count;
+      task = try_pop_from(work_lines_, index);
+    }
+  }
+
+  // Try to steal from the deques of the other workers.
+  if (!task && !deques_.empty())
+    task = steal_from_deques(index_hint, index);
+  return task;
+}
+
+bool thread_pool::park_if_inactive(std::stop_token stop_condition,
+                                   thread_sleep_data& sleep_object) noexcept {
+  // The sleep object identifies the loop; after a thread inversion, the loop of a worker can run
+  // on the OS thread of another worker, so the thread-local identity may belong to someone else.
+  // Workers use the sleep objects with their own indices; helpers use the ones above.
+  int worker_index = sleep_object.index();
+  if (worker_index < 0 || worker_index >= max_parallelism() ||
+      worker_index < active_workers_.load(std::memory_order_seq_cst))
+    return false;
+  // Finish the tasks in our deque first; we may have pushed them before being retired.
+  if (!deques_.empty() && !deques_[worker_index]->empty())
+    return false;
+  profiling::zone zone{CURRENT_LOCATION()};
+  zone.set_param("worker_index", static_cast<int64_t>(worker_index));
+  // We might have been woken up to execute a task; hand over the task to an active thread.
+  release_timer_keeper(sleep_object.index());
+  if (num_tasks_.maybe_positive())
+    (void)wake_idle_threads(1, 0);
+  // Sleep without setting the idle bit, so that notifiers don't wake us up.
+  // Note: `sleep_helper` allows thread inversions to happen while we are parked.
+  (void)sleep_object.sleep(stop_condition);
+  return true;
+}
+
 void thread_pool::execute_work(std::stop_token stop_condition, int index_hint,
                                thread_sleep_data& sleep_object) noexcept {
-  int work_line_count = work_lines_.size();
   int work_line_hint = index_hint;
+  spin_policy spin{max_spin_duration_};
+  int tasks_picked = 0;
+  // Set when we didn't find a task, even if the summary of `num_tasks_` said there might be one.
+  bool missed_task = false;
   while (!stop_condition.stop_requested()) {
     // Sync: no ordering guarantees needed here.
 
     // First check if we need to restore this thread to somebody else.
     this_thread::inversion_checkpoint();
 
-    if (num_tasks_.load(std::memory_order_acquire) == 0) {
+    // Workers that are not active anymore don't pick new tasks.
+    if (park_if_inactive(stop_condition, sleep_object))
+      continue;
+
+    // Enqueue the timer tasks that are due; this may give us something to execute.
+    fire_expired_timers();
+
+    // Busy threads only check the summary of `num_tasks_`; recounting is left to `sleep()`.
+    if (missed_task || !num_tasks_.maybe_positive()) {
       // Sync: don't move any sleep operations before this load.
-      // If there are no tasks, we can sleep.
-      work_line_hint = sleep_object.sleep(stop_condition);
+      // Producers waiting for room need to know that the pool is empty.
+      if (max_pending_tasks_ > 0)
+        wake_waiting_producer(true);
+      // If there are no tasks, spin for a while, then sleep. If we missed tasks, the summary may be
+      // stale; go directly to `sleep()`, which recounts the tasks and doesn't sleep if there are
+      // some.
+      auto idle_start = std::chrono::steady_clock::now();
+      auto budget = missed_task ? std::chrono::nanoseconds{0} : spin.budget();
+      if (budget.count() > 0 && spin_until_work(stop_condition, budget)) {
+        parks_avoided_.fetch_add(1, std::memory_order_relaxed);
+      } else {
+        parks_.fetch_add(1, std::memory_order_relaxed);
+        CONCORE2FULL_COUNT(sleeps_);
+        work_line_hint = sleep_object.sleep(stop_condition, &num_tasks_, &timers_);
+      }
+      spin.record_wait(std::chrono::steady_clock::now() - idle_start);
+      missed_task = false;
     }
 
     if (stop_condition.stop_requested())
       break;
+    // We might have been retired while waiting for tasks.
+    if (park_if_inactive(stop_condition, sleep_object))
+      continue;
 
     concore2full_task* to_execute{nullptr};
     int line_index = 0;
 
-    // Try to pop a task from the first thread data available.
-    for (int i = 0; i < 2 * work_line_count; i++) {
-      line_index = (i + work_line_hint) % work_line_count;
-      to_execute = work_lines_[line_index].try_pop();
-      if (to_execute)
-        break;
+    // Take tasks in the order of their priorities, except for every `starvation_limit_`-th task,
+    // for which we start with the lowest priority.
+    if (starvation_limit_ > 0 && tasks_picked % starvation_limit_ == starvation_limit_ - 1) {
+      to_execute = pop_from(low_priority_, work_line_hint, line_index);
+      if (!to_execute)
+        to_execute = pop_normal_priority(work_line_hint, line_index);
+      if (!to_execute)
+        to_execute = pop_from(high_priority_, work_line_hint, line_index);
+    } else {
+      to_execute = pop_from(high_priority_, work_line_hint, line_index);
+      if (!to_execute)
+        to_execute = pop_normal_priority(work_line_hint, line_index);
+      if (!to_execute)
+        to_execute = pop_from(low_priority_, work_line_hint, line_index);
     }
 
     // If we have a task, execute it.
     if (to_execute) {
       // We successfully popped a task; decrease the counter.
-      num_tasks_.fetch_sub(1, std::memory_order_relaxed);
+      num_tasks_.add(counter_shard(), -1, std::memory_order_relaxed);
+      if (max_pending_tasks_ > 0)
+        wake_waiting_producer(false);
+      // Don't keep the timers waiting while we execute the task.
+      release_timer_keeper(sleep_object.index());
+      tasks_picked++;
+      CONCORE2FULL_COUNT(tasks_executed_);
+#if CONCORE2FULL_SCHEDULER_STATS
+      if (line_index != current_line_index())
+        CONCORE2FULL_COUNT(tasks_stolen_);
+#endif
 
       profiling::zone zone2{CURRENT_LOCATION_N("execute")};
       zone2.set_param("task,x", to_execute);
@@ -354,7 +1360,12 @@ void thread_pool::execute_work(std::stop_token stop_condition, int index_hint,
       to_execute->task_function_(to_execute, line_index);
       continue;
     }
+    missed_task = true;
   }
+  release_timer_keeper(sleep_object.index());
 }
 
-} // namespace concore2full
\ No newline at end of file
+} // namespace concore2full
+void concore2full_get_thread_pool_stats(struct concore2full_thread_pool_stats* stats) {
+  *stats = concore2full::global_thread_pool().stats();
+}
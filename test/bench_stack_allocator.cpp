@@ -0,0 +1,75 @@
+#include "concore2full/detail/callcc.h"
+#include "concore2full/stack/hugepage_stack_allocator.h"
+#include "concore2full/stack/simple_stack_allocator.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <vector>
+
+using namespace concore2full;
+using detail::callcc;
+using detail::continuation_t;
+using detail::resume;
+
+namespace {
+
+//! Makes the memory pointed by `p` observable, so that the compiler keeps the writes to it.
+inline void escape(void* p) { asm volatile("" : : "g"(p) : "memory"); }
+
+//! A set of live coroutines, each touching a few pages of its own stack, that we can switch to.
+class coroutine_ring {
+public:
+  static constexpr int pages_touched = 3;
+
+  template <typename S> coroutine_ring(S salloc, int count) {
+    conts_.reserve(count);
+    for (int i = 0; i < count; i++) {
+      auto coro_fun = [this](continuation_t c) -> continuation_t {
+        char buffer[pages_touched * 4096];
+        while (!done_) {
+          for (int p = 0; p < pages_touched; p++)
+            buffer[p * 4096] = static_cast<char>(p);
+          escape(buffer);
+          c = resume(c);
+        }
+        return c;
+      };
+      conts_.push_back(callcc(std::allocator_arg, salloc, std::move(coro_fun)));
+    }
+  }
+  ~coroutine_ring() {
+    done_ = true;
+    for (auto& c : conts_)
+      c = resume(c);
+  }
+
+  //! Switch once to each coroutine in the ring.
+  void switch_all() {
+    for (auto& c : conts_)
+      c = resume(c);
+  }
+
+private:
+  std::vector<continuation_t> conts_;
+  bool done_{false};
+};
+
+constexpr int num_coroutines = 4096;
+constexpr std::size_t stack_size = 64 * 1024;
+
+} // namespace
+
+TEST_CASE("switching between many coroutines", "[.][benchmark]") {
+  BENCHMARK_ADVANCED("simple_stack_allocator")(Catch::Benchmark::Chronometer meter) {
+    coroutine_ring ring{stack::simple_stack_allocator{stack_size}, num_coroutines};
+    meter.measure([&] { ring.switch_all(); });
+  };
+  BENCHMARK_ADVANCED("hugepage_stack_allocator")(Catch::Benchmark::Chronometer meter) {
+    stack::hugepage_stack_slab slab{{.stack_size = stack_size}};
+    {
+      coroutine_ring ring{stack::hugepage_stack_allocator{slab}, num_coroutines};
+      meter.measure([&] { ring.switch_all(); });
+    }
+  };
+}
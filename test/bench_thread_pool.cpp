@@ -0,0 +1,305 @@
+#include "concore2full/thread_pool.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <latch>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+//! Task that fans out into two child tasks, until reaching the given depth.
+struct fan_out_task : concore2full_task {
+  concore2full::thread_pool* pool_;
+  int depth_;
+  std::latch* done_;
+
+  fan_out_task(concore2full::thread_pool* pool, int depth, std::latch* done)
+      : pool_(pool), depth_(depth), done_(done) {
+    task_function_ = &execute;
+    next_ = nullptr;
+  }
+
+  static void execute(concore2full_task* task, int) noexcept {
+    std::unique_ptr<fan_out_task> self{static_cast<fan_out_task*>(task)};
+    if (self->depth_ == 0) {
+      self->done_->count_down();
+      return;
+    }
+    for (int i = 0; i < 2; i++)
+      self->pool_->enqueue(new fan_out_task(self->pool_, self->depth_ - 1, self->done_));
+  }
+};
+
+//! Runs a fan-out tree of tasks of the given depth on `pool`.
+void run_fan_out(concore2full::thread_pool& pool, int depth) {
+  std::latch done{1 << depth};
+  pool.enqueue(new fan_out_task(&pool, depth, &done));
+  done.wait();
+}
+
+constexpr int fan_out_depth = 16;
+
+//! Task that does nothing.
+struct noop_task : concore2full_task {
+  noop_task() {
+    task_function_ = [](concore2full_task*, int) noexcept {};
+    next_ = nullptr;
+  }
+};
+
+//! Task that keeps a worker thread busy until `stop_` is set.
+struct busy_task : concore2full_task {
+  std::atomic<bool>* stop_;
+  std::atomic<int>* started_;
+
+  busy_task(std::atomic<bool>* stop, std::atomic<int>* started) : stop_(stop), started_(started) {
+    task_function_ = &execute;
+    next_ = nullptr;
+  }
+
+  static void execute(concore2full_task* task, int) noexcept {
+    auto* self = static_cast<busy_task*>(task);
+    self->started_->fetch_add(1);
+    while (!self->stop_->load(std::memory_order_relaxed))
+      std::this_thread::yield();
+  }
+};
+
+//! Background task that keeps busy for a while, and then re-enqueues itself, until `stop_` is set.
+struct background_task : concore2full_task {
+  concore2full::thread_pool* pool_;
+  std::atomic<bool>* stop_;
+  std::atomic<int>* active_;
+
+  background_task(concore2full::thread_pool* pool, std::atomic<bool>* stop,
+                  std::atomic<int>* active)
+      : pool_(pool), stop_(stop), active_(active) {
+    task_function_ = &execute;
+    next_ = nullptr;
+  }
+
+  static void execute(concore2full_task* task, int) noexcept {
+    auto* self = static_cast<background_task*>(task);
+    auto end = std::chrono::steady_clock::now() + std::chrono::microseconds{20};
+    while (std::chrono::steady_clock::now() < end)
+      ;
+    if (self->stop_->load(std::memory_order_relaxed))
+      self->active_->fetch_sub(1, std::memory_order_release);
+    else
+      self->pool_->enqueue(self);
+  }
+};
+
+//! Returns the current time, in nanoseconds.
+int64_t now_ns() {
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+//! Task that records the time at which it started.
+struct probe_task : concore2full_task {
+  std::atomic<int64_t> start_ns_{0};
+
+  probe_task() {
+    task_function_ = [](concore2full_task* task, int) noexcept {
+      static_cast<probe_task*>(task)->start_ns_.store(now_ns(), std::memory_order_release);
+    };
+    next_ = nullptr;
+  }
+};
+
+//! Returns the latencies (in ns) between enqueueing probe tasks with `priority` and their start,
+//! while the pool is loaded with normal-priority background work.
+std::vector<int64_t> probe_latencies(concore2full::task_priority priority, int num_probes) {
+  concore2full::thread_pool pool;
+  std::atomic<bool> stop{false};
+  int num_background = 4 * pool.available_parallelism();
+  std::atomic<int> active{num_background};
+  std::vector<background_task> background(num_background, background_task{&pool, &stop, &active});
+  for (auto& t : background)
+    pool.enqueue(&t);
+
+  // Enqueue the probes, at regular intervals.
+  std::vector<probe_task> probes(num_probes);
+  std::vector<int64_t> enqueue_times(num_probes);
+  for (int i = 0; i < num_probes; i++) {
+    enqueue_times[i] = now_ns();
+    pool.enqueue(&probes[i], priority);
+    std::this_thread::sleep_for(std::chrono::microseconds{100});
+  }
+
+  // Wait for the probes to start. If they are starved, stop the background work after a while.
+  auto all_started = [&] {
+    return std::all_of(probes.begin(), probes.end(),
+                       [](const probe_task& p) { return p.start_ns_.load() != 0; });
+  };
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{1};
+  while (!all_started() && std::chrono::steady_clock::now() < deadline)
+    std::this_thread::yield();
+  stop = true;
+  while (!all_started() || active.load(std::memory_order_acquire) > 0)
+    std::this_thread::yield();
+
+  std::vector<int64_t> latencies;
+  latencies.reserve(num_probes);
+  for (int i = 0; i < num_probes; i++)
+    latencies.push_back(probes[i].start_ns_.load() - enqueue_times[i]);
+  return latencies;
+}
+
+//! Task simulating a request in a server; records when it was enqueued and when it started.
+struct request_task : concore2full_task {
+  int64_t enqueue_ns_{0};
+  std::atomic<int64_t> start_ns_{0};
+
+  request_task() {
+    task_function_ = [](concore2full_task* task, int) noexcept {
+      auto* self = static_cast<request_task*>(task);
+      self->start_ns_.store(now_ns(), std::memory_order_release);
+      // Simulate some processing.
+      auto end = std::chrono::steady_clock::now() + std::chrono::microseconds{2};
+      while (std::chrono::steady_clock::now() < end)
+        ;
+    };
+    next_ = nullptr;
+  }
+};
+
+//! Returns the queueing delays (in ns) of `num_requests` requests, enqueued in bursts from outside
+//! of a pool that takes tasks in the given `order`.
+std::vector<int64_t> queueing_delays(concore2full::thread_pool::queue_order order,
+                                     int num_requests) {
+  concore2full::thread_pool pool{{.order = order}};
+  std::vector<request_task> requests(num_requests);
+  constexpr int burst_size = 256;
+  for (int i = 0; i < num_requests; i++) {
+    requests[i].enqueue_ns_ = now_ns();
+    pool.enqueue(&requests[i]);
+    if (i % burst_size == burst_size - 1)
+      std::this_thread::sleep_for(std::chrono::microseconds{200});
+  }
+  std::vector<int64_t> delays;
+  delays.reserve(num_requests);
+  for (auto& r : requests) {
+    while (r.start_ns_.load(std::memory_order_acquire) == 0)
+      std::this_thread::yield();
+    delays.push_back(r.start_ns_.load() - r.enqueue_ns_);
+  }
+  return delays;
+}
+
+//! Measures the cost of enqueueing a task (and extracting it back) from outside of a pool with
+//! `num_threads` threads, while all the worker threads are busy.
+void bench_enqueue_busy_pool(Catch::Benchmark::Chronometer& meter, int num_threads) {
+  concore2full::thread_pool pool{num_threads};
+  std::atomic<bool> stop{false};
+  std::atomic<int> started{0};
+  std::vector<busy_task> busy(num_threads, busy_task{&stop, &started});
+  for (auto& t : busy)
+    pool.enqueue(&t);
+  while (started.load() < num_threads)
+    std::this_thread::yield();
+
+  noop_task task;
+  meter.measure([&] {
+    pool.enqueue(&task);
+    return pool.extract_task(&task);
+  });
+
+  stop = true;
+}
+
+} // namespace
+
+TEST_CASE("thread_pool fan-out with work-stealing deques vs work lines", "[.][benchmark]") {
+  BENCHMARK_ADVANCED("work lines")(Catch::Benchmark::Chronometer meter) {
+    concore2full::thread_pool pool{{.use_work_stealing_deques = false}};
+    meter.measure([&] { run_fan_out(pool, fan_out_depth); });
+  };
+  BENCHMARK_ADVANCED("work-stealing deques")(Catch::Benchmark::Chronometer meter) {
+    concore2full::thread_pool pool{{.use_work_stealing_deques = true}};
+    meter.measure([&] { run_fan_out(pool, fan_out_depth); });
+  };
+}
+
+TEST_CASE("thread_pool enqueue cost with busy workers", "[.][benchmark]") {
+  for (int num_threads : {4, 16, 64}) {
+    BENCHMARK_ADVANCED("enqueue, " + std::to_string(num_threads) + " threads")
+    (Catch::Benchmark::Chronometer meter) { bench_enqueue_busy_pool(meter, num_threads); };
+  }
+}
+
+TEST_CASE("thread_pool request/response latency with and without spinning", "[.][benchmark]") {
+  for (auto max_spin : {std::chrono::nanoseconds{0}, std::chrono::nanoseconds{50'000}}) {
+    BENCHMARK_ADVANCED("max spin " + std::to_string(max_spin.count()) + "ns")
+    (Catch::Benchmark::Chronometer meter) {
+      concore2full::thread_pool pool{{.num_threads = 4, .max_spin_duration = max_spin}};
+      std::atomic<bool> done{false};
+      struct signal_task : concore2full_task {
+        std::atomic<bool>* done_;
+      } task;
+      task.done_ = &done;
+      task.task_function_ = [](concore2full_task* t, int) noexcept {
+        static_cast<signal_task*>(t)->done_->store(true, std::memory_order_release);
+      };
+      task.next_ = nullptr;
+      meter.measure([&] {
+        // Leave a short gap between requests, as in request/response workloads.
+        auto gap_end = std::chrono::steady_clock::now() + std::chrono::microseconds{5};
+        while (std::chrono::steady_clock::now() < gap_end)
+          ;
+        done.store(false, std::memory_order_relaxed);
+        pool.enqueue(&task);
+        while (!done.load(std::memory_order_acquire))
+          std::this_thread::yield();
+      });
+    };
+  }
+}
+
+TEST_CASE("thread_pool high-priority latency under background load", "[.][benchmark]") {
+  constexpr int num_probes = 1000;
+  for (auto priority : {concore2full::task_priority::normal, concore2full::task_priority::high}) {
+    auto latencies = probe_latencies(priority, num_probes);
+    std::sort(latencies.begin(), latencies.end());
+    std::printf("%s priority: p50 = %.1f us, p99 = %.1f us\n",
+                priority == concore2full::task_priority::high ? "high" : "normal",
+                latencies[num_probes / 2] / 1000.0, latencies[num_probes * 99 / 100] / 1000.0);
+  }
+}
+
+TEST_CASE("thread_pool fan-out scalability with the number of threads", "[.][benchmark]") {
+  int max_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int num_threads = 1;; num_threads = std::min(2 * num_threads, max_threads)) {
+    BENCHMARK_ADVANCED("fan-out, " + std::to_string(num_threads) + " threads")
+    (Catch::Benchmark::Chronometer meter) {
+      concore2full::thread_pool pool{num_threads};
+      meter.measure([&] { run_fan_out(pool, fan_out_depth); });
+    };
+    if (num_threads == max_threads)
+      break;
+  }
+}
+
+TEST_CASE("thread_pool queueing delay with LIFO, FIFO and hybrid work lines", "[.][benchmark]") {
+  using order_t = concore2full::thread_pool::queue_order;
+  constexpr int num_requests = 20'000;
+  const std::pair<order_t, const char*> orders[] = {
+      {order_t::lifo, "lifo"}, {order_t::fifo, "fifo"}, {order_t::hybrid, "hybrid"}};
+  for (auto [order, name] : orders) {
+    auto delays = queueing_delays(order, num_requests);
+    std::sort(delays.begin(), delays.end());
+    std::printf("%s: p50 = %.1f us, p99 = %.1f us, p999 = %.1f us\n", name,
+                delays[num_requests / 2] / 1000.0, delays[num_requests * 99 / 100] / 1000.0,
+                delays[num_requests * 999 / 1000] / 1000.0);
+  }
+}
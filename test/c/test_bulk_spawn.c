@@ -41,3 +41,21 @@ int test_basic_bulk_spawn() {
   free(frame);
   return 1;
 }
+
+int test_bulk_spawn_with_allocator() {
+  struct concore2full_stack_allocator salloc = concore2full_simple_stack_allocator(64 * 1024);
+
+  // Perform the spawn, using small stacks.
+  struct spawn_frame* frame = alloc_frame(3);
+  frame->captures_ = 11;
+  concore2full_bulk_spawn_with_allocator(&frame->base_, 3, &spawn_function, &salloc);
+  // Await the result from the spawn.
+  concore2full_bulk_await(&frame->base_);
+  // Check the result.
+  for (int i = 0; i < 3; ++i) {
+    if (frame->result_[i] != 24)
+      return 0;
+  }
+  free(frame);
+  return 1;
+}
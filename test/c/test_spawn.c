@@ -1,6 +1,7 @@
 #include "concore2full/c/spawn.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
 struct spawn_frame {
   struct concore2full_spawn_frame base_;
@@ -26,3 +27,44 @@ int test_basic_spawn() {
   // Check the result.
   return frame.result_ == 24;
 }
+
+static struct concore2full_stack malloc_allocate(struct concore2full_stack_allocator* self) {
+  // The size of the stack is stored directly in `data_`.
+  struct concore2full_stack stack;
+  stack.size_ = (uint64_t)(uintptr_t)self->data_;
+  stack.sp_ = (char*)malloc(stack.size_) + stack.size_;
+  return stack;
+}
+
+static void malloc_deallocate(struct concore2full_stack_allocator* self,
+                              struct concore2full_stack stack) {
+  free((char*)stack.sp_ - stack.size_);
+}
+
+int test_spawn_with_allocator() {
+  struct concore2full_stack_allocator salloc;
+  salloc.allocate_fn_ = &malloc_allocate;
+  salloc.deallocate_fn_ = &malloc_deallocate;
+  salloc.data_ = (void*)(uintptr_t)(64 * 1024);
+
+  // Perform the spawn, using our allocator.
+  struct spawn_frame frame;
+  frame.captures_ = 11;
+  concore2full_spawn_with_allocator(&frame.base_, &spawn_function, &salloc);
+  // Await the result from the spawn.
+  concore2full_await(&frame.base_);
+  // Check the result.
+  return frame.result_ == 24;
+}
+
+int test_spawn_with_mmap_allocator() {
+  struct concore2full_stack_allocator salloc = concore2full_mmap_stack_allocator(64 * 1024);
+
+  // Perform the spawn, using the mmap allocator.
+  struct spawn_frame frame;
+  frame.captures_ = 11;
+  concore2full_spawn_with_allocator(&frame.base_, &spawn_function, &salloc);
+  concore2full_await(&frame.base_);
+  // Check the result.
+  return frame.result_ == 24;
+}
@@ -0,0 +1,25 @@
+#include "concore2full/c/spawn.h"
+#include "concore2full/c/stack_stats.h"
+
+static void noop_function(struct concore2full_spawn_frame* frame) { (void)frame; }
+
+int test_stack_stats() {
+  struct concore2full_stack_stats before;
+  concore2full_get_stack_stats(&before);
+  // Spawn some work, which may need a coroutine stack.
+  struct concore2full_spawn_frame frame;
+  concore2full_spawn(&frame, &noop_function);
+  concore2full_await(&frame);
+  struct concore2full_stack_stats after;
+  concore2full_get_stack_stats(&after);
+  // Check the stats.
+  if (after.peak_live_stacks_ < after.live_stacks_)
+    return 0;
+  if (after.peak_live_bytes_ < after.live_bytes_)
+    return 0;
+  if (after.total_allocations_ < before.total_allocations_)
+    return 0;
+  if (after.timestamp_ns_ <= before.timestamp_ns_)
+    return 0;
+  return concore2full_stack_allocation_rate(&before, &after) >= 0.0;
+}
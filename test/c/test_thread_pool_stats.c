@@ -0,0 +1,21 @@
+#include "concore2full/c/spawn.h"
+#include "concore2full/c/thread_pool_stats.h"
+
+static void noop_function(struct concore2full_spawn_frame* frame) { (void)frame; }
+
+int test_thread_pool_stats() {
+  struct concore2full_thread_pool_stats before;
+  concore2full_get_thread_pool_stats(&before);
+  // Spawn some work; it's either executed by the thread pool, or extracted by the await.
+  struct concore2full_spawn_frame frame;
+  concore2full_spawn(&frame, &noop_function);
+  concore2full_await(&frame);
+  struct concore2full_thread_pool_stats after;
+  concore2full_get_thread_pool_stats(&after);
+  // Check the stats; they never decrease.
+  if (after.tasks_executed_ < before.tasks_executed_)
+    return 0;
+  if (after.tasks_extracted_ < before.tasks_extracted_)
+    return 0;
+  return after.sleeps_ >= before.sleeps_ && after.wakeups_ >= before.wakeups_;
+}
@@ -1,4 +1,6 @@
 #include "concore2full/spawn.h"
+#include "concore2full/stack/mmap_stack_allocator.h"
+#include "concore2full/sync_execute.h"
 
 #include <catch2/catch_test_macros.hpp>
 
@@ -45,3 +47,53 @@ TEST_CASE("bulk_spawn result can be returned from functions", "[bulk_spawn]") {
   // Assert
   REQUIRE(sum.load() == 45);
 }
+
+TEST_CASE("bulk_spawn can use a custom stack allocator", "[bulk_spawn]") {
+  // Arrange
+  static constexpr int count = 10;
+  std::atomic<int> sum{0};
+  concore2full::stack::mmap_stack_allocator salloc{64 * 1024};
+
+  // Act
+  auto op{concore2full::bulk_spawn(std::allocator_arg, salloc, count,
+                                   [&sum](int index) { sum += index; })};
+  op.await();
+
+  // Assert
+  REQUIRE(sum.load() == 45);
+}
+
+TEST_CASE("bulk_spawn can spread the work over the worker threads", "[bulk_spawn]") {
+  // Arrange
+  static constexpr int count = 10;
+  std::atomic<int> sum{0};
+
+  // Act
+  auto op{concore2full::bulk_spawn(concore2full::round_robin_workers, count,
+                                   [&sum](int index) { sum += index; })};
+  op.await();
+
+  // Assert
+  REQUIRE(sum.load() == 45);
+}
+
+TEST_CASE("bulk_spawn can execute work on a given thread pool", "[bulk_spawn]") {
+  // Arrange
+  static constexpr int count = 10;
+  concore2full::thread_pool pool{2};
+  std::atomic<int> sum{0};
+
+  // Act
+  concore2full::sync_execute([&] {
+    auto op{concore2full::bulk_spawn(pool, count, [&sum](int index) { sum += index; })};
+    op.await();
+  });
+
+  // Assert
+  REQUIRE(sum.load() == 45);
+#if CONCORE2FULL_SCHEDULER_STATS
+  auto stats = pool.stats();
+  REQUIRE(stats.tasks_executed_ + stats.tasks_extracted_ == count);
+#endif
+  pool.join();
+}
@@ -0,0 +1,118 @@
+#include "concore2full/detail/cpu_topology.h"
+#include "concore2full/thread_pool.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using concore2full::detail::cpu_info;
+
+namespace {
+
+//! Writes `value` to the file at `path`, creating the parent directories.
+void write_file(const std::filesystem::path& path, const std::string& value) {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream{path} << value << "\n";
+}
+
+//! Creates a fake sysfs CPU directory for a machine with two packages (one NUMA node and one L3
+//! cache each), each with two cores with two SMT threads. CPU `c` is on package `(c / 2) % 2`, and
+//! the SMT siblings are `c` and `c + 4`.
+std::filesystem::path create_fake_sysfs() {
+  auto root = std::filesystem::temp_directory_path() / "concore2full_test_cpu_topology";
+  std::filesystem::remove_all(root);
+  write_file(root / "online", "0-7");
+  for (int cpu = 0; cpu < 8; cpu++) {
+    int package = (cpu / 2) % 2;
+    auto dir = root / ("cpu" + std::to_string(cpu));
+    write_file(dir / "topology" / "core_id", std::to_string(cpu % 2));
+    write_file(dir / "topology" / "physical_package_id", std::to_string(package));
+    write_file(dir / "cache" / "index0" / "level", "1");
+    write_file(dir / "cache" / "index0" / "id", std::to_string(cpu % 4));
+    write_file(dir / "cache" / "index3" / "level", "3");
+    write_file(dir / "cache" / "index3" / "id", std::to_string(package));
+    std::filesystem::create_directories(dir / ("node" + std::to_string(package)));
+  }
+  return root;
+}
+
+} // namespace
+
+TEST_CASE("read_cpu_topology reads the topology from sysfs", "[cpu_topology]") {
+  // Arrange
+  auto root = create_fake_sysfs();
+
+  // Act
+  auto cpus = concore2full::detail::read_cpu_topology(root.string());
+
+  // Assert
+  REQUIRE(cpus.size() == 8);
+  for (int i = 0; i < 8; i++) {
+    REQUIRE(cpus[i].cpu_ == i);
+    REQUIRE(cpus[i].core_id_ == i % 2);
+    REQUIRE(cpus[i].package_id_ == (i / 2) % 2);
+    REQUIRE(cpus[i].l3_id_ == (i / 2) % 2);
+    REQUIRE(cpus[i].node_id_ == (i / 2) % 2);
+  }
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("read_cpu_topology returns nothing if the directory doesn't exist", "[cpu_topology]") {
+  REQUIRE(concore2full::detail::read_cpu_topology("/nonexistent/cpu/directory").empty());
+}
+
+TEST_CASE("topology_steal_order visits SMT siblings, then the same L3, then remote CPUs",
+          "[cpu_topology]") {
+  // Arrange
+  auto root = create_fake_sysfs();
+  auto cpus = concore2full::detail::read_cpu_topology(root.string());
+  std::filesystem::remove_all(root);
+
+  // Act
+  auto order0 = concore2full::detail::topology_steal_order(cpus, 0);
+  auto order3 = concore2full::detail::topology_steal_order(cpus, 3);
+
+  // Assert
+  REQUIRE(order0 == std::vector<int>{4, 1, 5, 2, 3, 6, 7});
+  REQUIRE(order3 == std::vector<int>{7, 6, 2, 4, 5, 0, 1});
+}
+
+TEST_CASE("cpu_distance works with partially known topology", "[cpu_topology]") {
+  cpu_info a{.cpu_ = 0, .core_id_ = 0, .package_id_ = 0};
+  cpu_info b{.cpu_ = 1, .core_id_ = 1, .package_id_ = 0};
+  cpu_info c{.cpu_ = 2, .core_id_ = 0, .package_id_ = 1};
+  REQUIRE(concore2full::detail::cpu_distance(a, a) == 0);
+  REQUIRE(concore2full::detail::cpu_distance(a, b) == 3);
+  REQUIRE(concore2full::detail::cpu_distance(a, c) == 4);
+}
+
+TEST_CASE("thread_pool with pinned workers can execute work", "[cpu_topology]") {
+  // Arrange
+  concore2full::thread_pool sut{{.num_threads = 4, .pin_worker_threads = true}};
+  std::atomic<int> executed{0};
+  struct counting_task : concore2full_task {
+    std::atomic<int>* executed_;
+  };
+  std::vector<counting_task> tasks(100);
+  for (auto& t : tasks) {
+    t.task_function_ = [](concore2full_task* t, int) noexcept {
+      static_cast<counting_task*>(t)->executed_->fetch_add(1);
+    };
+    t.next_ = nullptr;
+    t.executed_ = &executed;
+  }
+
+  // Act
+  sut.enqueue_bulk(tasks.data(), static_cast<int>(tasks.size()));
+  while (executed.load() < 100)
+    std::this_thread::yield();
+
+  // Assert
+  REQUIRE(executed.load() == 100);
+  sut.join();
+}
@@ -0,0 +1,73 @@
+#include "concore2full/detail/sharded_counter.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <thread>
+#include <vector>
+
+using concore2full::detail::sharded_counter;
+
+TEST_CASE("sharded_counter: starts at zero", "[sharded_counter]") {
+  // Arrange
+  sharded_counter sut{4};
+
+  // Assert
+  REQUIRE(sut.num_shards() == 4);
+  REQUIRE(sut.load() == 0);
+}
+
+TEST_CASE("sharded_counter: value is the sum of all the shards", "[sharded_counter]") {
+  // Arrange
+  sharded_counter sut{3};
+
+  // Act
+  sut.add(0, 5);
+  sut.add(1, 2);
+  sut.add(2, -4);
+  // Indices are taken modulo the number of shards.
+  sut.add(4, 1);
+
+  // Assert
+  REQUIRE(sut.load() == 4);
+}
+
+TEST_CASE("sharded_counter: the summary is cleared only by a recount", "[sharded_counter]") {
+  // Arrange
+  sharded_counter sut{4};
+  REQUIRE_FALSE(sut.maybe_positive());
+
+  // Act & Assert
+  sut.add(1, 2);
+  REQUIRE(sut.maybe_positive());
+  sut.add(2, -1);
+  REQUIRE(sut.recount() == 1);
+  REQUIRE(sut.maybe_positive());
+  sut.add(3, -1);
+  // Decrements don't clear the summary.
+  REQUIRE(sut.maybe_positive());
+  REQUIRE(sut.recount() == 0);
+  REQUIRE_FALSE(sut.maybe_positive());
+}
+
+TEST_CASE("sharded_counter: adding and subtracting on different shards", "[sharded_counter]") {
+  // Arrange
+  sharded_counter sut{8};
+  constexpr int num_threads = 4;
+  constexpr int num_iterations = 10'000;
+
+  // Act: each thread increments on its own shard, and decrements on the next one.
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&sut, t] {
+      for (int i = 0; i < num_iterations; i++) {
+        sut.add(t, 1);
+        sut.add(t + 1, -1, std::memory_order_relaxed);
+      }
+    });
+  }
+  for (auto& t : threads)
+    t.join();
+
+  // Assert
+  REQUIRE(sut.load() == 0);
+}
@@ -1,13 +1,19 @@
 #include "concore2full/global_thread_pool.h"
 #include "concore2full/profiling.h"
 #include "concore2full/spawn.h"
+#include "concore2full/stack/mmap_stack_allocator.h"
+#include "concore2full/stack/simple_stack_allocator.h"
 #include "concore2full/sync_execute.h"
+#include "thread_pool_test_utils.h"
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <atomic>
 #include <chrono>
+#include <functional>
 #include <latch>
 #include <semaphore>
+#include <thread>
 
 using namespace std::chrono_literals;
 
@@ -71,6 +77,186 @@ TEST_CASE("spawn can execute a function that returns a reference", "[spawn]") {
   REQUIRE(y == 13);
 }
 
+TEST_CASE("spawn can execute work with a given priority", "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  for (auto priority : {concore2full::task_priority::low, concore2full::task_priority::normal,
+                        concore2full::task_priority::high}) {
+    // Arrange
+    bool called{false};
+    std::binary_semaphore done{0};
+
+    // Act
+    auto op{concore2full::spawn(priority, [&]() -> int {
+      called = true;
+      done.release();
+      return 13;
+    })};
+    done.acquire();
+    auto res = op.await();
+
+    // Assert
+    REQUIRE(called);
+    REQUIRE(res == 13);
+  }
+}
+
+TEST_CASE("spawn can execute work with worker affinity", "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  for (int worker_index = 0; worker_index < 3; worker_index++) {
+    // Arrange
+    bool called{false};
+
+    // Act
+    auto op{concore2full::spawn(concore2full::worker_affinity{worker_index}, [&]() -> int {
+      called = true;
+      return 13;
+    })};
+    auto res = op.await();
+
+    // Assert
+    REQUIRE(called);
+    REQUIRE(res == 13);
+  }
+}
+
+TEST_CASE("spawn can execute work on a given thread pool", "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::thread_pool pool{2};
+  auto global_before = concore2full::global_thread_pool().stats();
+
+  // Act
+  int res = concore2full::sync_execute([&] {
+    std::latch started{1};
+    auto op{concore2full::spawn(pool, [&]() -> int {
+      started.count_down();
+      return 17;
+    })};
+    // Ensure that the work is not executed inplace by `await`.
+    started.wait();
+    return op.await();
+  });
+
+  // Assert
+  REQUIRE(res == 17);
+#if CONCORE2FULL_SCHEDULER_STATS
+  REQUIRE(pool.stats().tasks_executed_ == 1);
+  auto global_after = concore2full::global_thread_pool().stats();
+  REQUIRE(global_after.tasks_executed_ == global_before.tasks_executed_);
+#else
+  (void)global_before;
+#endif
+  pool.join();
+}
+
+TEST_CASE("spawn on a given thread pool can be awaited before the work starts", "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::thread_pool pool{1};
+
+  // Act: keep the only worker of the pool busy, so that `await` extracts the work from the pool.
+  int res = concore2full::sync_execute([&] {
+    worker_blocker blocker{pool};
+    auto op{concore2full::spawn(pool, []() -> int { return 19; })};
+    int r = op.await();
+    blocker.release();
+    return r;
+  });
+
+  // Assert
+  REQUIRE(res == 19);
+#if CONCORE2FULL_SCHEDULER_STATS
+  REQUIRE(pool.stats().tasks_extracted_ == 1);
+#endif
+  pool.join();
+}
+
+TEST_CASE("bounded spawn on a full pool with reject policy executes the work at await",
+          "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  using policy_t = concore2full::thread_pool::overflow_policy;
+  concore2full::thread_pool pool{
+      {.num_threads = 1, .max_pending_tasks = 1, .on_overflow = policy_t::reject}};
+  std::atomic<bool> executed{false};
+  bool executed_before_await{true};
+
+  // Act: keep the only worker busy, and fill the pool.
+  int res = concore2full::sync_execute([&] {
+    worker_blocker blocker{pool};
+    auto queued{concore2full::spawn(concore2full::bounded, pool, []() -> int { return 1; })};
+    auto rejected{concore2full::spawn(concore2full::bounded, pool, [&]() -> int {
+      executed = true;
+      return 19;
+    })};
+    executed_before_await = executed.load();
+    int r = rejected.await();
+    blocker.release();
+    return r + queued.await();
+  });
+
+  // Assert
+  REQUIRE(res == 20);
+  REQUIRE_FALSE(executed_before_await);
+#if CONCORE2FULL_SCHEDULER_STATS
+  // The rejected work never entered the pool.
+  REQUIRE(pool.stats().tasks_extracted_ == 0);
+#endif
+  pool.join();
+}
+
+TEST_CASE("bounded spawn on a full pool with caller_runs policy executes the work before returning",
+          "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  using policy_t = concore2full::thread_pool::overflow_policy;
+  concore2full::thread_pool pool{
+      {.num_threads = 1, .max_pending_tasks = 1, .on_overflow = policy_t::caller_runs}};
+  std::atomic<bool> executed{false};
+
+  // Act: keep the only worker busy, and fill the pool.
+  bool executed_on_spawn = concore2full::sync_execute([&] {
+    worker_blocker blocker{pool};
+    auto queued{concore2full::spawn(concore2full::bounded, pool, [] {})};
+    auto op{concore2full::spawn(concore2full::bounded, pool, [&] { executed = true; })};
+    bool r = executed.load();
+    blocker.release();
+    op.await();
+    queued.await();
+    return r;
+  });
+
+  // Assert
+  REQUIRE(executed_on_spawn);
+  pool.join();
+}
+
+TEST_CASE("bounded spawn on a full pool with suspend_producer policy waits for room", "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  using policy_t = concore2full::thread_pool::overflow_policy;
+  concore2full::thread_pool pool{
+      {.num_threads = 1, .max_pending_tasks = 1, .on_overflow = policy_t::suspend_producer}};
+  std::atomic<bool> queued_done{false};
+
+  // Act: keep the only worker busy, and fill the pool.
+  bool room_made = concore2full::sync_execute([&] {
+    worker_blocker blocker{pool};
+    auto queued{concore2full::spawn(concore2full::bounded, pool, [&] { queued_done = true; })};
+    // While waiting for room, the producer helps the pool, executing the queued work.
+    auto op{concore2full::spawn(concore2full::bounded, pool, [] {})};
+    bool r = queued_done.load();
+    blocker.release();
+    op.await();
+    queued.await();
+    return r;
+  });
+
+  // Assert
+  REQUIRE(room_made);
+  pool.join();
+}
+
 TEST_CASE("escaping_spawn can execute work", "[spawn]") {
   concore2full::profiling::zone zone{CURRENT_LOCATION()};
   // Arrange
@@ -307,3 +493,106 @@ TEST_CASE("copyable_spawn: multiple awaits start before the task", "[spawn]") {
   REQUIRE(res2 == 13);
   REQUIRE(res3 == 13);
 }
+
+TEST_CASE("spawn can use a custom stack allocator", "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::stack::mmap_stack_allocator salloc{64 * 1024};
+  bool called{false};
+  std::binary_semaphore done{0};
+
+  // Act
+  auto op{concore2full::spawn(std::allocator_arg, salloc, [&]() -> int {
+    called = true;
+    done.release();
+    return 13;
+  })};
+  done.acquire();
+  auto res = op.await();
+
+  // Assert
+  REQUIRE(called);
+  REQUIRE(res == 13);
+}
+
+TEST_CASE("escaping_spawn and copyable_spawn can use a custom stack allocator", "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::stack::simple_stack_allocator salloc{64 * 1024};
+
+  // Act
+  auto f1 = concore2full::escaping_spawn(std::allocator_arg, salloc, []() -> int { return 13; });
+  auto f2 = concore2full::copyable_spawn(std::allocator_arg, salloc, []() -> int { return 17; });
+  auto f3 = f2;
+
+  // Assert
+  REQUIRE(f1.await() == 13);
+  REQUIRE(f2.await() == 17);
+  REQUIRE(f3.await() == 17);
+}
+
+TEST_CASE("spawn with lazy_stack can execute work", "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  bool called{false};
+  std::binary_semaphore done{0};
+
+  // Act
+  auto op{concore2full::spawn(concore2full::lazy_stack, [&]() -> int {
+    called = true;
+    done.release();
+    return 13;
+  })};
+  done.acquire();
+  auto res = op.await();
+
+  // Assert
+  REQUIRE(called);
+  REQUIRE(res == 13);
+}
+
+TEST_CASE("spawn with lazy_stack: await arrives before the work is done", "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  std::binary_semaphore started{0};
+  std::atomic<bool> finish{false};
+  std::thread releaser;
+
+  // Act
+  int res = concore2full::sync_execute([&] {
+    auto op{concore2full::spawn(concore2full::lazy_stack, [&]() -> int {
+      started.release();
+      while (!finish.load())
+        std::this_thread::sleep_for(1ms);
+      return 13;
+    })};
+    started.acquire();
+    releaser = std::thread{[&] {
+      std::this_thread::sleep_for(10ms);
+      finish = true;
+    }};
+    return op.await();
+  });
+  releaser.join();
+
+  // Assert
+  REQUIRE(res == 13);
+}
+
+TEST_CASE("spawn with lazy_stack can be nested", "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  std::function<int(int)> fib = [&](int n) -> int {
+    if (n < 2)
+      return n;
+    auto op{concore2full::spawn(concore2full::lazy_stack, [&] { return fib(n - 1); })};
+    int r = fib(n - 2);
+    return r + op.await();
+  };
+
+  // Act
+  int res = concore2full::sync_execute([&] { return fib(18); });
+
+  // Assert
+  REQUIRE(res == 2584);
+}
@@ -1,10 +1,22 @@
+#include "concore2full/detail/callcc.h"
+#include "concore2full/stack/any_stack_allocator.h"
+#include "concore2full/stack/hugepage_stack_allocator.h"
+#include "concore2full/stack/mmap_stack_allocator.h"
+#include "concore2full/stack/pooled_stack_allocator.h"
+#include "concore2full/stack/reclaiming_stack_allocator.h"
 #include "concore2full/stack/simple_stack_allocator.h"
+#include "concore2full/stack/stack_stats.h"
+#include "concore2full/stack/stack_usage.h"
 #include "concore2full/stack/stack_allocator.h"
 
 #include <catch2/catch_test_macros.hpp>
 
 #include <algorithm>
+#include <chrono>
 #include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
 
 using namespace concore2full;
 
@@ -80,3 +92,462 @@ TEST_CASE("simple_stack_allocator allocates custom amount of memory", "[stack_al
   // Destroy
   sut.deallocate(stack);
 }
+
+TEST_CASE("pooled_stack_allocator models stack_allocator", "[stack_allocator]") {
+  REQUIRE(stack::stack_allocator<stack::pooled_stack_allocator>);
+}
+
+TEST_CASE("pooled_stack_allocator can allocate memory that can be filled", "[stack_allocator]") {
+  // Arrange
+  stack::stack_pool pool{{.stack_size = 64 * 1024}};
+  stack::pooled_stack_allocator sut{pool};
+  constexpr uint8_t fill_value = 0xab;
+
+  // Act: fill the memory with a special value
+  auto stack = sut.allocate();
+  auto end = reinterpret_cast<uint8_t*>(stack.sp);
+  auto start = end - stack.size;
+  std::fill(start, end, fill_value);
+
+  // Assert
+  REQUIRE(stack.size == 64 * 1024);
+  auto it = std::find_if(start, end, [](uint8_t v) { return v != fill_value; });
+  REQUIRE(it == end);
+
+  // Destroy
+  sut.deallocate(stack);
+}
+
+TEST_CASE("pooled_stack_allocator reuses deallocated stacks", "[stack_allocator]") {
+  // Arrange
+  stack::stack_pool pool{{.stack_size = 64 * 1024}};
+  stack::pooled_stack_allocator sut{pool};
+  auto stack1 = sut.allocate();
+  sut.deallocate(stack1);
+
+  // Act
+  auto stack2 = sut.allocate();
+
+  // Assert
+  REQUIRE(stack2.sp == stack1.sp);
+  REQUIRE(stack2.size == stack1.size);
+
+  // Destroy
+  sut.deallocate(stack2);
+}
+
+TEST_CASE("pooled_stack_allocator moves excess stacks to the global list", "[stack_allocator]") {
+  // Arrange
+  stack::stack_pool pool{{.stack_size = 64 * 1024, .high_watermark = 4, .low_watermark = 2}};
+  stack::pooled_stack_allocator sut{pool};
+  std::vector<stack::stack_t> stacks;
+  for (int i = 0; i < 5; i++)
+    stacks.push_back(sut.allocate());
+
+  // Act
+  for (auto s : stacks)
+    sut.deallocate(s);
+
+  // Assert
+  REQUIRE(pool.global_free_count() == 3);
+}
+
+TEST_CASE("pooled_stack_allocator limits the size of the global list", "[stack_allocator]") {
+  // Arrange
+  stack::stack_pool pool{{.stack_size = 64 * 1024,
+                          .high_watermark = 1,
+                          .low_watermark = 0,
+                          .max_global_stacks = 2}};
+  stack::pooled_stack_allocator sut{pool};
+  std::vector<stack::stack_t> stacks;
+  for (int i = 0; i < 5; i++)
+    stacks.push_back(sut.allocate());
+
+  // Act
+  for (auto s : stacks)
+    sut.deallocate(s);
+
+  // Assert
+  REQUIRE(pool.global_free_count() == 2);
+}
+
+TEST_CASE("pooled_stack_allocator can take stacks released by other threads",
+          "[stack_allocator]") {
+  // Arrange
+  stack::stack_pool pool{{.stack_size = 64 * 1024}};
+  stack::pooled_stack_allocator sut{pool};
+  auto stack1 = sut.allocate();
+
+  // Act: release the stack on a thread that exits, then allocate again.
+  std::thread t{[&] { sut.deallocate(stack1); }};
+  t.join();
+  auto stack2 = sut.allocate();
+
+  // Assert
+  REQUIRE(pool.global_free_count() == 0);
+  REQUIRE(stack2.sp == stack1.sp);
+
+  // Destroy
+  sut.deallocate(stack2);
+}
+
+TEST_CASE("mmap_stack_allocator models stack_allocator", "[stack_allocator]") {
+  REQUIRE(stack::stack_allocator<stack::mmap_stack_allocator>);
+}
+
+TEST_CASE("mmap_stack_allocator allocates memory that can be filled", "[stack_allocator]") {
+  // Arrange
+  stack::mmap_stack_allocator sut;
+  constexpr uint8_t fill_value = 0xab;
+
+  // Act: fill the memory with a special value
+  auto stack = sut.allocate();
+  auto end = reinterpret_cast<uint8_t*>(stack.sp);
+  auto start = end - stack.size;
+  std::fill(start, end, fill_value);
+
+  // Assert
+  REQUIRE(stack.size >= stack::mmap_stack_allocator::default_size_);
+  auto it = std::find_if(start, end, [](uint8_t v) { return v != fill_value; });
+  REQUIRE(it == end);
+
+  // Destroy
+  sut.deallocate(stack);
+}
+
+TEST_CASE("mmap_stack_allocator rounds the stack size to the page size", "[stack_allocator]") {
+  // Arrange
+  auto page = stack::mmap_stack_allocator::page_size();
+
+  // Act
+  stack::mmap_stack_allocator sut(10);
+  auto stack = sut.allocate();
+
+  // Assert
+  REQUIRE(stack.size == page);
+  REQUIRE(reinterpret_cast<uintptr_t>(stack.sp) % page == 0);
+
+  // Destroy
+  sut.deallocate(stack);
+}
+
+TEST_CASE("mmap_stack_allocator can be used to create coroutines", "[stack_allocator]") {
+  // Arrange
+  bool called = false;
+
+  // Act
+  auto c = detail::callcc(std::allocator_arg, stack::mmap_stack_allocator{64 * 1024},
+                          [&called](detail::continuation_t c) -> detail::continuation_t {
+                            called = true;
+                            return c;
+                          });
+
+  // Assert
+  REQUIRE(called);
+  REQUIRE(c == nullptr);
+}
+
+TEST_CASE("hugepage_stack_allocator models stack_allocator", "[stack_allocator]") {
+  REQUIRE(stack::stack_allocator<stack::hugepage_stack_allocator>);
+}
+
+TEST_CASE("hugepage_stack_allocator allocates memory that can be filled", "[stack_allocator]") {
+  // Arrange
+  stack::hugepage_stack_slab slab{{.stack_size = 16 * 1024, .region_size = 1}};
+  stack::hugepage_stack_allocator salloc{slab};
+
+  // Act
+  std::vector<stack::stack_t> stacks;
+  for (int i = 0; i < 10; i++) {
+    auto s = salloc.allocate();
+    std::fill_n(static_cast<char*>(s.sp) - s.size, s.size, static_cast<char>(i));
+    stacks.push_back(s);
+  }
+
+  // Assert
+  REQUIRE(slab.region_count() == 1);
+  REQUIRE(slab.region_size() == stack::hugepage_stack_slab::transparent_huge_page_size());
+  // The first stack starts at the beginning of the region, which is aligned to the huge page size.
+  auto region_start = reinterpret_cast<uintptr_t>(stacks[0].sp) - stacks[0].size;
+  auto alignment = slab.backing() == stack::hugepage_stack_slab::page_backing::explicit_huge_pages
+                       ? stack::hugepage_stack_slab::huge_page_size()
+                       : stack::hugepage_stack_slab::transparent_huge_page_size();
+  REQUIRE(region_start % alignment == 0);
+  for (int i = 0; i < 10; i++) {
+    REQUIRE(stacks[i].size == 16 * 1024);
+    auto* begin = static_cast<char*>(stacks[i].sp) - stacks[i].size;
+    REQUIRE(std::all_of(begin, begin + stacks[i].size, [i](char c) { return c == i; }));
+  }
+  for (auto s : stacks)
+    salloc.deallocate(s);
+}
+
+TEST_CASE("hugepage_stack_allocator reuses deallocated stacks", "[stack_allocator]") {
+  // Arrange
+  stack::hugepage_stack_slab slab{{.stack_size = 16 * 1024, .region_size = 1}};
+  stack::hugepage_stack_allocator salloc{slab};
+  auto s1 = salloc.allocate();
+  salloc.deallocate(s1);
+
+  // Act
+  auto s2 = salloc.allocate();
+
+  // Assert
+  REQUIRE(s2.sp == s1.sp);
+  salloc.deallocate(s2);
+}
+
+TEST_CASE("hugepage_stack_allocator maps new regions when needed", "[stack_allocator]") {
+  // Arrange
+  stack::hugepage_stack_slab slab{{.stack_size = 1024 * 1024, .region_size = 1}};
+  stack::hugepage_stack_allocator salloc{slab};
+
+  // Act
+  std::vector<stack::stack_t> stacks;
+  for (int i = 0; i < 5; i++)
+    stacks.push_back(salloc.allocate());
+
+  // Assert
+  REQUIRE(slab.region_count() == 3);
+  for (auto s : stacks)
+    salloc.deallocate(s);
+}
+
+TEST_CASE("hugepage_stack_allocator can be used to create coroutines", "[stack_allocator]") {
+  // Arrange
+  stack::hugepage_stack_slab slab;
+  bool called = false;
+
+  // Act
+  auto c = detail::callcc(std::allocator_arg, stack::hugepage_stack_allocator{slab},
+                          [&called](detail::continuation_t c) -> detail::continuation_t {
+                            called = true;
+                            return c;
+                          });
+
+  // Assert
+  REQUIRE(called);
+  REQUIRE(c == nullptr);
+}
+
+TEST_CASE("reclaiming_stack_allocator models stack_allocator", "[stack_allocator]") {
+  REQUIRE(stack::stack_allocator<stack::reclaiming_stack_allocator>);
+}
+
+TEST_CASE("reclaiming_stack_allocator reuses the most recently freed stack", "[stack_allocator]") {
+  // Arrange
+  stack::reclaiming_stack_cache cache{{.stack_size = 64 * 1024}};
+  stack::reclaiming_stack_allocator salloc{cache};
+  auto s1 = salloc.allocate();
+  auto s2 = salloc.allocate();
+  salloc.deallocate(s1);
+  salloc.deallocate(s2);
+
+  // Act
+  auto s3 = salloc.allocate();
+
+  // Assert
+  REQUIRE(s3.sp == s2.sp);
+  REQUIRE(cache.cached_count() == 1);
+  salloc.deallocate(s3);
+}
+
+TEST_CASE("reclaiming_stack_allocator gives back the pages of idle stacks", "[stack_allocator]") {
+  // Arrange
+  stack::reclaiming_stack_cache cache{{.stack_size = 64 * 1024, .idle_period = {}}};
+  stack::reclaiming_stack_allocator salloc{cache};
+  auto s = salloc.allocate();
+  std::fill_n(static_cast<char*>(s.sp) - s.size, s.size, 'x');
+
+  // Act
+  salloc.deallocate(s);
+
+  // Assert
+  REQUIRE(cache.cached_count() == 1);
+  REQUIRE(cache.dirty_bytes() == 0);
+  // The stack can still be used.
+  auto s2 = salloc.allocate();
+  REQUIRE(s2.sp == s.sp);
+  std::fill_n(static_cast<char*>(s2.sp) - s2.size, s2.size, 'y');
+  salloc.deallocate(s2);
+}
+
+TEST_CASE("reclaiming_stack_allocator keeps the dirty stacks within the byte budget",
+          "[stack_allocator]") {
+  // Arrange
+  stack::reclaiming_stack_cache cache{
+      {.stack_size = 64 * 1024, .idle_period = std::chrono::hours(1), .byte_budget = 128 * 1024}};
+  stack::reclaiming_stack_allocator salloc{cache};
+  std::vector<stack::stack_t> stacks;
+  for (int i = 0; i < 5; i++)
+    stacks.push_back(salloc.allocate());
+
+  // Act
+  for (auto s : stacks)
+    salloc.deallocate(s);
+
+  // Assert
+  REQUIRE(cache.cached_count() == 5);
+  REQUIRE(cache.dirty_bytes() == 128 * 1024);
+}
+
+TEST_CASE("reclaiming_stack_allocator limits the number of cached stacks", "[stack_allocator]") {
+  // Arrange
+  stack::reclaiming_stack_cache cache{{.stack_size = 64 * 1024, .max_cached_stacks = 2}};
+  stack::reclaiming_stack_allocator salloc{cache};
+  std::vector<stack::stack_t> stacks;
+  for (int i = 0; i < 5; i++)
+    stacks.push_back(salloc.allocate());
+
+  // Act
+  for (auto s : stacks)
+    salloc.deallocate(s);
+
+  // Assert
+  REQUIRE(cache.cached_count() == 2);
+  REQUIRE(cache.dirty_bytes() == 2 * 64 * 1024);
+}
+
+TEST_CASE("any_stack_allocator models stack_allocator", "[stack_allocator]") {
+  REQUIRE(stack::stack_allocator<stack::any_stack_allocator>);
+}
+
+TEST_CASE("any_stack_allocator forwards to the wrapped allocator", "[stack_allocator]") {
+  // Arrange
+  stack::any_stack_allocator sut{stack::simple_stack_allocator{10}};
+
+  // Act
+  auto stack = sut.allocate();
+
+  // Assert
+  REQUIRE(stack.size == 10);
+  REQUIRE(stack.sp != nullptr);
+
+  // Destroy
+  sut.deallocate(stack);
+}
+
+//! Uses about 32 KiB of stack.
+[[gnu::noinline]] int use_32k_stack() {
+  volatile char buffer[32 * 1024];
+  for (auto& c : buffer)
+    c = 1;
+  return std::accumulate(std::begin(buffer), std::end(buffer), 0);
+}
+
+TEST_CASE("stack stats count the live coroutine stacks", "[stack_allocator]") {
+  // Arrange
+  auto before = stack::get_stack_stats();
+  stack::stack_stats inside{};
+
+  // Act
+  auto c = detail::callcc(std::allocator_arg, stack::simple_stack_allocator{64 * 1024},
+                          [&inside](detail::continuation_t c) -> detail::continuation_t {
+                            inside = stack::get_stack_stats();
+                            return c;
+                          });
+  auto after = stack::get_stack_stats();
+
+  // Assert
+  REQUIRE(c == nullptr);
+  REQUIRE(inside.live_stacks_ >= 1);
+  REQUIRE(inside.live_bytes_ >= 64 * 1024);
+  REQUIRE(inside.peak_live_stacks_ >= inside.live_stacks_);
+  REQUIRE(inside.peak_live_bytes_ >= inside.live_bytes_);
+  REQUIRE(after.total_allocations_ >= before.total_allocations_ + 1);
+  REQUIRE(after.timestamp_ns_ > before.timestamp_ns_);
+  REQUIRE(stack::allocation_rate(before, after) > 0.0);
+}
+
+TEST_CASE("stack stats add up the stacks used on all the threads", "[stack_allocator]") {
+  // Arrange
+  constexpr int num_threads = 8;
+  constexpr int coroutines_per_thread = 100;
+  auto before = stack::get_stack_stats();
+  std::vector<std::thread> threads;
+
+  // Act
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([] {
+      for (int i = 0; i < coroutines_per_thread; i++)
+        (void)detail::callcc(std::allocator_arg, stack::simple_stack_allocator{64 * 1024},
+                             [](detail::continuation_t c) -> detail::continuation_t { return c; });
+    });
+  }
+  for (auto& t : threads)
+    t.join();
+  auto after = stack::get_stack_stats();
+
+  // Assert
+  uint64_t num_coroutines = num_threads * coroutines_per_thread;
+  REQUIRE(after.total_allocations_ >= before.total_allocations_ + num_coroutines);
+  REQUIRE(after.peak_live_stacks_ >= after.live_stacks_);
+  REQUIRE(after.peak_live_bytes_ >= after.live_bytes_);
+}
+
+TEST_CASE("stack stats count the stacks cached by the allocators", "[stack_allocator]") {
+  // Arrange
+  auto before = stack::get_stack_stats();
+  stack::stack_stats with_cached{};
+  {
+    stack::stack_pool pool{{.stack_size = 64 * 1024}};
+    stack::pooled_stack_allocator salloc{pool};
+
+    // Act
+    salloc.deallocate(salloc.allocate());
+    salloc.deallocate(salloc.allocate());
+    with_cached = stack::get_stack_stats();
+  }
+  auto after = stack::get_stack_stats();
+
+  // Assert
+  REQUIRE(with_cached.cached_stacks_ >= before.cached_stacks_ + 1);
+  REQUIRE(with_cached.cached_bytes_ >= before.cached_bytes_ + 64 * 1024);
+  REQUIRE(after.cached_stacks_ + 1 <= with_cached.cached_stacks_);
+}
+
+TEST_CASE("stack usage can be sampled for coroutines", "[stack_allocator]") {
+  // Arrange
+  constexpr std::size_t stack_size = 256 * 1024 + 64;
+  auto& histogram = stack::stack_usage_for(stack_size);
+  histogram.reset();
+  stack::enable_stack_usage_sampling(true);
+
+  // Act
+  (void)detail::callcc(std::allocator_arg, stack::simple_stack_allocator{stack_size},
+                       [](detail::continuation_t c) -> detail::continuation_t {
+                         REQUIRE(use_32k_stack() == 32 * 1024);
+                         return c;
+                       });
+  stack::enable_stack_usage_sampling(false);
+
+  // Assert
+  REQUIRE(histogram.count() == 1);
+  REQUIRE(histogram.max_usage() >= 32 * 1024);
+  REQUIRE(histogram.max_usage() < stack_size);
+  REQUIRE(histogram.usage_percentile(1.0) >= histogram.max_usage());
+  REQUIRE(stack::recommended_stack_size(histogram) >= 2 * histogram.max_usage());
+  REQUIRE(stack::recommended_stack_size(histogram) <= stack_size);
+}
+
+TEST_CASE("stack usage histogram groups samples in buckets", "[stack_allocator]") {
+  // Arrange
+  stack::stack_usage_histogram sut{1024 * 1024};
+
+  // Act
+  sut.record(100);
+  sut.record(1024);
+  sut.record(3000);
+  sut.record(5000);
+
+  // Assert
+  REQUIRE(sut.count() == 4);
+  REQUIRE(sut.max_usage() == 5000);
+  REQUIRE(sut.bucket(0) == 2);
+  REQUIRE(sut.bucket(1) == 0);
+  REQUIRE(sut.bucket(2) == 1);
+  REQUIRE(sut.bucket(3) == 1);
+  REQUIRE(sut.usage_percentile(0.5) == 1024);
+  REQUIRE(sut.usage_percentile(1.0) == 8 * 1024);
+  REQUIRE(stack::recommended_stack_size(sut) == 16 * 1024);
+}
@@ -2,10 +2,15 @@
 #include "concore2full/profiling.h"
 #include "concore2full/suspend.h"
 #include "concore2full/sync_execute.h"
+#include "concore2full/thread_pool.h"
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <chrono>
+#include <functional>
+#include <latch>
 #include <semaphore>
+#include <thread>
 
 TEST_CASE("suspend actually suspends the thread of execution", "[suspend]") {
   concore2full::profiling::zone zone{CURRENT_LOCATION()};
@@ -103,3 +108,76 @@ TEST_CASE("notify is called before suspend", "[suspend]") {
   // Assert
   REQUIRE(reched_after_suspend);
 }
+
+TEST_CASE("suspend on a given thread pool helps that thread pool", "[suspend]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::thread_pool pool{1};
+  concore2full::suspend_token token;
+  std::latch worker_busy{1};
+  std::latch release_worker{1};
+  struct fun_task : concore2full_task {
+    std::function<void()> f_;
+    explicit fun_task(std::function<void()> f) : f_(std::move(f)) {
+      task_function_ = [](concore2full_task* t, int) noexcept {
+        static_cast<fun_task*>(t)->f_();
+      };
+    }
+  };
+  fun_task blocker{[&] {
+    worker_busy.count_down();
+    release_worker.wait();
+  }};
+  // Can only be executed by the suspended thread, as the only worker is busy.
+  std::thread::id wakeup_thread;
+  fun_task wakeup{[&] {
+    wakeup_thread = std::this_thread::get_id();
+    token.notify();
+    release_worker.count_down();
+  }};
+  pool.enqueue(&blocker);
+  worker_busy.wait();
+  pool.enqueue(&wakeup);
+
+  // Act
+  concore2full::suspend(pool, token);
+
+  // Assert
+  REQUIRE(wakeup_thread == std::this_thread::get_id());
+  pool.join();
+}
+
+TEST_CASE("sleep_for suspends the execution, without blocking the worker", "[suspend]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  struct fun_task : concore2full_task {
+    explicit fun_task(std::function<void()> f) : f_(std::move(f)) { task_function_ = &execute; }
+    static void execute(concore2full_task* task, int) { static_cast<fun_task*>(task)->f_(); }
+    std::function<void()> f_;
+  };
+  concore2full::thread_pool pool{1};
+  std::atomic<bool> sleeper_done{false};
+  std::atomic<bool> other_task_during_sleep{false};
+  std::chrono::steady_clock::duration slept{};
+  fun_task other{[&] { other_task_during_sleep = !sleeper_done.load(); }};
+  std::latch sleeper_started{1};
+  fun_task sleeper{[&] {
+    auto start = std::chrono::steady_clock::now();
+    sleeper_started.count_down();
+    concore2full::sleep_for(pool, std::chrono::milliseconds{20});
+    slept = std::chrono::steady_clock::now() - start;
+    sleeper_done = true;
+  }};
+
+  // Act: the only worker sleeps, and another task is enqueued meanwhile.
+  pool.enqueue(&sleeper);
+  sleeper_started.wait();
+  pool.enqueue(&other);
+  while (!sleeper_done.load())
+    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+
+  // Assert
+  REQUIRE(slept >= std::chrono::milliseconds{20});
+  REQUIRE(other_task_during_sleep.load());
+  pool.join();
+}
@@ -1,93 +1,106 @@
+#include "concore2full/global_thread_pool.h"
+#include "concore2full/stack/pooled_stack_allocator.h"
+#include "concore2full/stack/stack_stats.h"
 #include "concore2full/thread_pool.h"
+#include "thread_pool_test_utils.h"
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cstring>
 #include <functional>
 #include <latch>
-
-using namespace std::chrono_literals;
-
-//! Wait until `predicate` returns true, using the pool-waiting technique.
-//! Throws if `timeout` is reached.
-void wait_until(std::predicate auto predicate, std::chrono::milliseconds sleep_time = 1ms,
-                std::chrono::milliseconds timeout = 1s) {
-  concore2full::profiling::zone zone{CURRENT_LOCATION()};
-  auto start_time = std::chrono::high_resolution_clock::now();
-  while (true) {
-    // If the predicate is true, we are done.
-    if (predicate())
-      return;
-    // Check for timeout.
-    if (std::chrono::high_resolution_clock::now() - start_time > timeout) {
-      printf("Timeout\n");
-      throw std::runtime_error("Timeout");
-    }
-    // Sleep for a while.
-    std::this_thread::sleep_for(sleep_time);
-  }
-}
-
-struct std_fun_task : concore2full_task {
-  std::function<void()> f_;
-  std_fun_task() = default;
-  explicit std_fun_task(std::function<void()> f) : f_(std::move(f)) {
-    task_function_ = &execute;
+#include <memory>
+#include <vector>
+
+namespace {
+//! Task that records the index of the work line it was executed from.
+struct line_recording_task : concore2full_task {
+  std::atomic<int> line_index_{-1};
+
+  line_recording_task() {
+    task_function_ = [](concore2full_task* task, int line_index) noexcept {
+      static_cast<line_recording_task*>(task)->line_index_.store(line_index,
+                                                                 std::memory_order_release);
+    };
     next_ = nullptr;
   }
-
-  static void execute(concore2full_task* task, int) noexcept {
-    auto self = static_cast<std_fun_task*>(task);
-    std::invoke(self->f_);
-  }
 };
+} // namespace
 
-//! Test that ensures that `pool` has at least `num_threads` parallelism.
-void ensure_parallelism(concore2full::thread_pool& pool, int num_threads) {
-  if (num_threads <= 2)
-    return;
+TEST_CASE("thread_pool can be default constructed, and has some parallelism", "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Act
+  concore2full::thread_pool sut;
 
+  // Assert
+  REQUIRE(sut.available_parallelism() > 1);
+}
+TEST_CASE("thread_pool can be default constructed with specified number of threads",
+          "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Act
+  concore2full::thread_pool sut(13);
+
+  // Assert
+  REQUIRE(sut.available_parallelism() == 13);
+}
+TEST_CASE("thread_pool with zero threads executes tasks only on helping threads",
+          "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
   // Arrange
-  std::atomic<int> tasks_started{0};
-  std::atomic<int> tasks_done{0};
-  auto core_task_fun = [&tasks_started, &tasks_done, num_threads]() {
-    (void)tasks_started.fetch_add(1, std::memory_order_release);
-    wait_until([&] { return tasks_started.load(std::memory_order_acquire) >= num_threads; });
-    (void)tasks_done.fetch_add(1, std::memory_order_release);
-  };
-  int num_tasks = 3 * num_threads;
-  std::vector<std_fun_task> tasks;
-  tasks.reserve(num_tasks);
-  for (int i = 0; i < num_tasks; i++) {
-    tasks.emplace_back(std::function<void()>([&core_task_fun] { core_task_fun(); }));
-  }
+  concore2full::thread_pool sut(0);
+  std::stop_source ss;
+  std_fun_task task{[&] { ss.request_stop(); }};
 
   // Act
-  for (auto& t : tasks) {
-    pool.enqueue(&t);
-  }
+  sut.enqueue(&task);
+  sut.offer_help_until(ss.get_token());
 
   // Assert
-  wait_until([&] { return tasks_done.load() >= num_tasks; });
+  REQUIRE(sut.available_parallelism() == 0);
+  REQUIRE(sut.set_parallelism(2) == 0);
+  REQUIRE(ss.stop_requested());
+  sut.join();
 }
-
-TEST_CASE("thread_pool can be default constructed, and has some parallelism", "[thread_pool]") {
+TEST_CASE("thread_pool can prewarm coroutine stacks for its workers", "[thread_pool]") {
   concore2full::profiling::zone zone{CURRENT_LOCATION()};
   // Act
-  concore2full::thread_pool sut;
+  concore2full::thread_pool sut{{.num_threads = 3, .prewarmed_stacks_per_worker = 4}};
 
   // Assert
-  REQUIRE(sut.available_parallelism() > 1);
+  REQUIRE(sut.available_parallelism() == 3);
+  REQUIRE(concore2full::stack::get_stack_stats().cached_stacks_ >= 12);
 }
-TEST_CASE("thread_pool can be default constructed with specified number of threads",
+TEST_CASE("thread_pool keeps at most a full stack cache of prewarmed stacks per worker",
           "[thread_pool]") {
   concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  auto& stack_pool = concore2full::stack::default_stack_pool();
+  auto global_before = stack_pool.global_free_count();
+  const std::size_t limit = stack_pool.high_watermark();
+
   // Act
-  concore2full::thread_pool sut(13);
+  concore2full::thread_pool sut{
+      {.num_threads = 2, .prewarmed_stacks_per_worker = 2 * static_cast<int>(limit)}};
+
+  // Assert: the workers keep full caches, and nothing was spilled to the global list.
+  REQUIRE(concore2full::stack::get_stack_stats().cached_stacks_ >= 2 * limit);
+  REQUIRE(stack_pool.global_free_count() <= global_before);
+  sut.join();
+}
+TEST_CASE("global thread pool cannot be configured after it is created", "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  (void)concore2full::global_thread_pool();
+
+  // Act
+  bool res = concore2full::configure_global_thread_pool({.prewarmed_stacks_per_worker = 1});
 
   // Assert
-  REQUIRE(sut.available_parallelism() == 13);
+  REQUIRE_FALSE(res);
 }
 TEST_CASE("thread_pool can execute tasks", "[thread_pool]") {
   concore2full::profiling::zone zone{CURRENT_LOCATION()};
@@ -104,6 +117,30 @@ TEST_CASE("thread_pool can execute tasks", "[thread_pool]") {
   // Assert
   REQUIRE(called);
 }
+TEST_CASE("thread_pool pushes tasks enqueued from a worker to the worker's line",
+          "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  constexpr int num_tasks = 10;
+  // With one thread, the worker has line 0, and the external threads use lines 0 and 1.
+  concore2full::thread_pool sut{{.num_threads = 1, .use_work_stealing_deques = false}};
+  line_recording_task children[num_tasks];
+  std::vector<std_fun_task> parents;
+  parents.reserve(num_tasks);
+  for (int i = 0; i < num_tasks; i++)
+    parents.emplace_back([&sut, &children, i] { sut.enqueue(&children[i]); });
+
+  // Act
+  for (auto& p : parents)
+    sut.enqueue(&p);
+  for (auto& c : children)
+    wait_until([&] { return c.line_index_.load(std::memory_order_acquire) >= 0; });
+
+  // Assert
+  for (auto& c : children)
+    REQUIRE(c.line_index_.load() == 0);
+  sut.join();
+}
 TEST_CASE("thread_pool can execute two tasks in parallel", "[thread_pool]") {
   concore2full::profiling::zone zone{CURRENT_LOCATION()};
   // Arrange
@@ -181,6 +218,73 @@ TEST_CASE("thread_pool can enqueue multiple tasks at once, and execute them", "[
   REQUIRE(count.load() == num_tasks);
 }
 
+TEST_CASE("thread_pool can extract tasks added with enqueue_bulk", "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  constexpr int num_tasks = 10'000;
+  concore2full::thread_pool sut(4);
+  std::vector<std::atomic<int>> executed(num_tasks);
+  struct indexed_task : concore2full_task {
+    std::vector<std::atomic<int>>* executed_;
+    int index_;
+    indexed_task(std::vector<std::atomic<int>>* executed, int index)
+        : executed_(executed), index_(index) {
+      task_function_ = &execute;
+      next_ = nullptr;
+    }
+    static void execute(concore2full_task* task, int) noexcept {
+      auto self = static_cast<indexed_task*>(task);
+      (*self->executed_)[self->index_]++;
+    }
+  };
+  std::vector<indexed_task> tasks;
+  tasks.reserve(num_tasks);
+  for (int i = 0; i < num_tasks; i++)
+    tasks.emplace_back(&executed, i);
+
+  // Act
+  sut.enqueue_bulk(&tasks[0], num_tasks);
+  // Extract the tasks in reverse order; the ones that we extract are executed here.
+  for (int i = num_tasks - 1; i >= 0; i--) {
+    if (sut.extract_task(&tasks[i]))
+      indexed_task::execute(&tasks[i], 0);
+  }
+  wait_until([&] {
+    return std::all_of(executed.begin(), executed.end(), [](auto& e) { return e.load() > 0; });
+  });
+
+  // Assert
+  REQUIRE(std::all_of(executed.begin(), executed.end(), [](auto& e) { return e.load() == 1; }));
+}
+
+TEST_CASE("thread_pool doesn't use extracted tasks after extract_task returns", "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  constexpr int num_rounds = 10'000;
+  concore2full::thread_pool sut(2);
+  std::atomic<int> executed{0};
+  int extracted = 0;
+
+  // Act: race the workers with the extraction; immediately overwrite and free the extracted
+  // tasks. The tasks executed by the pool are kept alive until the end.
+  std::vector<std::unique_ptr<std_fun_task>> tasks;
+  tasks.reserve(num_rounds);
+  for (int i = 0; i < num_rounds; i++) {
+    auto& task = tasks.emplace_back(std::make_unique<std_fun_task>([&executed] { executed++; }));
+    sut.enqueue(task.get());
+    if (sut.extract_task(task.get())) {
+      extracted++;
+      std::memset(static_cast<concore2full_task*>(task.get()), 0xff, sizeof(concore2full_task));
+      task.reset();
+    }
+  }
+  wait_until([&] { return executed.load() + extracted == num_rounds; });
+
+  // Assert
+  REQUIRE(executed.load() + extracted == num_rounds);
+  sut.join();
+}
+
 TEST_CASE("thread_pool allows another thread to help executing work", "[thread_pool]") {
   concore2full::profiling::zone zone{CURRENT_LOCATION()};
   // Arrange
@@ -242,3 +346,468 @@ TEST_CASE("thread_pool still functions after a helping thread left the pool", "[
 
   sut.join();
 }
+
+TEST_CASE("thread_pool wakes up all the sleeping threads, even with more than 64 threads",
+          "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::thread_pool sut(70);
+  REQUIRE(sut.available_parallelism() == 70);
+
+  // Act & Assert
+  // Let the threads go to sleep between the rounds, so that they need to be woken up again.
+  for (int i = 0; i < 3; i++) {
+    ensure_parallelism(sut, sut.available_parallelism());
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+
+  sut.join();
+}
+
+namespace {
+//! Executes `count` tasks on `pool`, one after another, waiting for each of them to complete.
+void run_tasks_one_by_one(concore2full::thread_pool& pool, int count) {
+  std::atomic<int> done{0};
+  std_fun_task task{[&done] { done.fetch_add(1, std::memory_order_release); }};
+  for (int i = 0; i < count; i++) {
+    pool.enqueue(&task);
+    while (done.load(std::memory_order_acquire) <= i)
+      std::this_thread::yield();
+  }
+}
+} // namespace
+
+TEST_CASE("thread_pool idle threads spin before going to sleep", "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Spinning is disabled on single-core machines.
+  if (std::thread::hardware_concurrency() <= 1)
+    return;
+  // Arrange
+  concore2full::thread_pool sut{{.num_threads = 2, .max_spin_duration = 10ms}};
+
+  // Act
+  run_tasks_one_by_one(sut, 100);
+
+  // Assert
+  auto stats = sut.spin_statistics();
+  REQUIRE(stats.parks_avoided > 0);
+  sut.join();
+}
+
+TEST_CASE("thread_pool idle threads go directly to sleep if spinning is disabled",
+          "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::thread_pool sut{{.num_threads = 2, .max_spin_duration = 0ns}};
+
+  // Act
+  run_tasks_one_by_one(sut, 100);
+
+  // Assert
+  auto stats = sut.spin_statistics();
+  REQUIRE(stats.parks_avoided == 0);
+  REQUIRE(stats.parks > 0);
+  sut.join();
+}
+
+namespace {
+//! The order in which tasks were executed.
+struct execution_order {
+  std::vector<int> ids_;
+  std::atomic<int> count_{0};
+};
+
+//! Task that records its ID in an `execution_order` object, when executed.
+struct recording_priority_task : concore2full_task {
+  int id_;
+  execution_order* order_;
+
+  recording_priority_task(int id, execution_order* order) : id_(id), order_(order) {
+    task_function_ = &execute;
+    next_ = nullptr;
+  }
+
+  static void execute(concore2full_task* task, int) noexcept {
+    auto* self = static_cast<recording_priority_task*>(task);
+    self->order_->ids_.push_back(self->id_);
+    self->order_->count_.fetch_add(1, std::memory_order_release);
+  }
+};
+} // namespace
+
+TEST_CASE("thread_pool executes tasks with higher priority first", "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::thread_pool sut{1};
+  worker_blocker blocker{sut};
+  execution_order order;
+  recording_priority_task low{0, &order};
+  recording_priority_task normal{1, &order};
+  recording_priority_task high{2, &order};
+
+  // Act
+  sut.enqueue(&low, concore2full::task_priority::low);
+  sut.enqueue(&normal, concore2full::task_priority::normal);
+  sut.enqueue(&high, concore2full::task_priority::high);
+  blocker.release();
+  wait_until([&] { return order.count_.load(std::memory_order_acquire) == 3; });
+
+  // Assert
+  REQUIRE(order.ids_ == std::vector<int>{2, 1, 0});
+  sut.join();
+}
+
+TEST_CASE("thread_pool doesn't starve low-priority tasks", "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::thread_pool sut{{.num_threads = 1, .starvation_limit = 4}};
+  worker_blocker blocker{sut};
+  constexpr int num_high = 20;
+  execution_order order;
+  recording_priority_task low{-1, &order};
+  std::vector<recording_priority_task> high;
+  high.reserve(num_high);
+  for (int i = 0; i < num_high; i++)
+    high.emplace_back(i, &order);
+
+  // Act
+  sut.enqueue(&low, concore2full::task_priority::low);
+  for (auto& t : high)
+    sut.enqueue(&t, concore2full::task_priority::high);
+  blocker.release();
+  wait_until([&] { return order.count_.load(std::memory_order_acquire) == num_high + 1; });
+
+  // Assert: the low-priority task is not executed after all the high-priority ones.
+  auto low_position = std::find(order.ids_.begin(), order.ids_.end(), -1) - order.ids_.begin();
+  REQUIRE(low_position < 4);
+  sut.join();
+}
+
+TEST_CASE("thread_pool can enqueue tasks for specific workers", "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::thread_pool sut{3};
+  constexpr int num_tasks = 7;
+  line_recording_task tasks[num_tasks];
+
+  // Act
+  for (int i = 0; i < num_tasks; i++)
+    sut.enqueue_on(i, &tasks[i]);
+
+  // Assert: each task is executed from the line of the targeted worker.
+  for (int i = 0; i < num_tasks; i++) {
+    wait_until([&] { return tasks[i].line_index_.load(std::memory_order_acquire) >= 0; });
+    REQUIRE(tasks[i].line_index_.load() == i % 3);
+  }
+  sut.join();
+}
+
+TEST_CASE("thread_pool can bulk enqueue tasks spread over the workers", "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::thread_pool sut{3};
+  constexpr int num_tasks = 8;
+  line_recording_task tasks[num_tasks];
+
+  // Act
+  sut.enqueue_bulk_on_workers(tasks, num_tasks);
+
+  // Assert: task `i` is executed from the line of worker `i % 3`.
+  for (int i = 0; i < num_tasks; i++) {
+    wait_until([&] { return tasks[i].line_index_.load(std::memory_order_acquire) >= 0; });
+    REQUIRE(tasks[i].line_index_.load() == i % 3);
+  }
+  sut.join();
+}
+
+TEST_CASE("thread_pool keeps scheduling statistics", "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::thread_pool sut{2};
+  constexpr int num_tasks = 10;
+  line_recording_task tasks[num_tasks];
+  line_recording_task to_extract;
+
+  // Act
+  for (auto& t : tasks)
+    sut.enqueue(&t);
+  for (auto& t : tasks)
+    wait_until([&] { return t.line_index_.load(std::memory_order_acquire) >= 0; });
+  // Keep both workers busy, so that we can extract a task.
+  worker_blocker blocker1{sut};
+  worker_blocker blocker2{sut};
+  sut.enqueue(&to_extract);
+  bool extracted = sut.extract_task(&to_extract);
+  blocker1.release();
+  blocker2.release();
+  if (!extracted)
+    wait_until([&] { return to_extract.line_index_.load(std::memory_order_acquire) >= 0; });
+
+  // Assert
+  auto stats = sut.stats();
+#if CONCORE2FULL_SCHEDULER_STATS
+  REQUIRE(stats.tasks_executed_ == num_tasks + 2 + (extracted ? 0 : 1));
+  REQUIRE(stats.tasks_extracted_ == (extracted ? 1 : 0));
+  uint64_t sum_executed = 0;
+  for (int i = 0; i <= sut.max_parallelism(); i++)
+    sum_executed += sut.worker_stats(i).tasks_executed_;
+  REQUIRE(sum_executed == stats.tasks_executed_);
+#else
+  REQUIRE(stats.tasks_executed_ == 0);
+#endif
+  sut.join();
+}
+
+TEST_CASE("thread_pool can decrease and increase its parallelism at runtime", "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::thread_pool sut{4};
+  REQUIRE(sut.max_parallelism() == 4);
+  ensure_parallelism(sut, 4);
+
+  // Act: shrink the pool, and enqueue tasks to the workers.
+  REQUIRE(sut.set_parallelism(1) == 1);
+  REQUIRE(sut.available_parallelism() == 1);
+  constexpr int num_tasks = 6;
+  line_recording_task tasks[num_tasks];
+  for (int i = 0; i < num_tasks; i++)
+    sut.enqueue_on(i, &tasks[i]);
+
+  // Assert: all the tasks go to the only active worker.
+  for (auto& t : tasks) {
+    wait_until([&] { return t.line_index_.load(std::memory_order_acquire) >= 0; });
+    REQUIRE(t.line_index_.load() == 0);
+  }
+  run_tasks_one_by_one(sut, 10);
+
+  // Act & Assert: grow the pool back.
+  REQUIRE(sut.set_parallelism(4) == 4);
+  ensure_parallelism(sut, 4);
+  sut.join();
+}
+
+TEST_CASE("thread_pool can grow beyond its initial number of threads, up to max_threads",
+          "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::thread_pool sut{{.num_threads = 2, .max_threads = 5}};
+  REQUIRE(sut.available_parallelism() == 2);
+  REQUIRE(sut.max_parallelism() == 5);
+
+  // Act
+  int n1 = sut.set_parallelism(5);
+  int n2 = sut.set_parallelism(100);
+
+  // Assert
+  REQUIRE(n1 == 5);
+  REQUIRE(n2 == 5);
+  ensure_parallelism(sut, 5);
+  REQUIRE(sut.set_parallelism(0) == 1);
+  run_tasks_one_by_one(sut, 10);
+  sut.join();
+}
+
+TEST_CASE("thread_pool takes tasks from the work lines in the configured order", "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  using order_t = concore2full::thread_pool::queue_order;
+  for (auto order : {order_t::lifo, order_t::fifo, order_t::hybrid}) {
+    // Arrange
+    concore2full::thread_pool sut{{.num_threads = 1, .order = order}};
+    constexpr int num_tasks = 10;
+    std::atomic<int> position{0};
+    std::vector<int> positions(num_tasks, -1);
+    std::vector<std_fun_task> tasks;
+    tasks.reserve(num_tasks);
+    for (int i = 0; i < num_tasks; i++)
+      tasks.emplace_back([&position, &positions, i] { positions[i] = position++; });
+
+    // Act: while the only worker is blocked, add the tasks to its line.
+    worker_blocker blocker{sut};
+    for (auto& t : tasks)
+      sut.enqueue_on(0, &t);
+    blocker.release();
+    wait_until([&] { return position.load() == num_tasks; });
+
+    // Assert: the worker owns the line, so it takes the newest task first, unless in FIFO mode.
+    for (int i = 0; i < num_tasks; i++) {
+      int expected = order == order_t::fifo ? i : num_tasks - 1 - i;
+      REQUIRE(positions[i] == expected);
+    }
+    sut.join();
+  }
+}
+
+TEST_CASE("thread_pool executes tasks enqueued with a delay after the delay passes",
+          "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::thread_pool sut{4};
+  constexpr int num_tasks = 20;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::chrono::steady_clock::time_point> executed_at(num_tasks);
+  std::atomic<int> num_executed{0};
+  std::vector<std_fun_task> tasks;
+  tasks.reserve(num_tasks);
+  for (int i = 0; i < num_tasks; i++)
+    tasks.emplace_back([&, i] {
+      executed_at[i] = std::chrono::steady_clock::now();
+      num_executed++;
+    });
+  auto delay_of = [](int i) { return std::chrono::milliseconds{(i * 7) % 40}; };
+
+  // Act: enqueue the tasks in a different order than their deadlines, with the pool idle.
+  std::this_thread::sleep_for(5ms);
+  for (int i = 0; i < num_tasks; i++)
+    sut.enqueue_after(delay_of(i), &tasks[i]);
+  wait_until([&] { return num_executed.load() == num_tasks; });
+
+  // Assert
+  for (int i = 0; i < num_tasks; i++)
+    REQUIRE(executed_at[i] - start >= delay_of(i));
+  sut.join();
+}
+
+TEST_CASE("thread_pool wakes up for a timer earlier than the pending ones", "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::thread_pool sut{2};
+  std::atomic<bool> late_executed{false};
+  std::atomic<bool> early_executed{false};
+  std_fun_task late{[&] { late_executed = true; }};
+  std_fun_task early{[&] { early_executed = true; }};
+
+  // Act: the idle threads wait for the late timer; then we add an earlier one.
+  sut.enqueue_after(300ms, &late);
+  std::this_thread::sleep_for(5ms);
+  sut.enqueue_at(std::chrono::steady_clock::now() + 5ms, &early);
+  wait_until([&] { return early_executed.load(); }, 1ms, 200ms);
+
+  // Assert
+  REQUIRE_FALSE(late_executed.load());
+  wait_until([&] { return late_executed.load(); });
+  sut.join();
+}
+
+TEST_CASE("thread_pool rejects tasks with try_enqueue when full", "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  using policy_t = concore2full::thread_pool::overflow_policy;
+  concore2full::thread_pool sut{
+      {.num_threads = 1, .max_pending_tasks = 4, .on_overflow = policy_t::reject}};
+  std::atomic<int> executed{0};
+  std::vector<std_fun_task> tasks;
+  for (int i = 0; i < 6; i++)
+    tasks.emplace_back([&executed] { executed++; });
+  worker_blocker blocker{sut};
+  for (int i = 0; i < 4; i++)
+    REQUIRE(sut.try_enqueue(&tasks[i]));
+
+  // Act
+  bool accepted = sut.try_enqueue(&tasks[4]);
+  bool accepted_bounded = sut.enqueue_bounded(&tasks[5]);
+  blocker.release();
+  wait_until([&] { return executed.load() == 4; });
+
+  // Assert
+  REQUIRE_FALSE(accepted);
+  REQUIRE_FALSE(accepted_bounded);
+  // After the pool drains, there is room again.
+  REQUIRE(sut.try_enqueue(&tasks[4]));
+  wait_until([&] { return executed.load() == 5; });
+  sut.join();
+}
+
+TEST_CASE("thread_pool does not let a single producer exceed a large capacity", "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::thread_pool sut{{.num_threads = 1, .max_pending_tasks = 1000}};
+  std::atomic<int> executed{0};
+  std::vector<std_fun_task> tasks;
+  for (int i = 0; i < 1100; i++)
+    tasks.emplace_back([&executed] { executed++; });
+  worker_blocker blocker{sut};
+
+  // Act
+  int accepted = 0;
+  for (auto& t : tasks)
+    accepted += sut.try_enqueue(&t) ? 1 : 0;
+  blocker.release();
+  wait_until([&] { return executed.load() == accepted; });
+
+  // Assert
+  REQUIRE(accepted == 1000);
+  sut.join();
+}
+
+TEST_CASE("thread_pool executes tasks on the calling thread when full, with caller_runs policy",
+          "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  using policy_t = concore2full::thread_pool::overflow_policy;
+  concore2full::thread_pool sut{
+      {.num_threads = 1, .max_pending_tasks = 4, .on_overflow = policy_t::caller_runs}};
+  std::atomic<int> executed{0};
+  std::vector<std_fun_task> tasks;
+  for (int i = 0; i < 4; i++)
+    tasks.emplace_back([&executed] { executed++; });
+  struct overflow_task : concore2full_task {
+    std::thread::id thread_;
+    int line_index_{-1};
+  } overflow;
+  overflow.task_function_ = [](concore2full_task* task, int line_index) noexcept {
+    auto self = static_cast<overflow_task*>(task);
+    self->thread_ = std::this_thread::get_id();
+    self->line_index_ = line_index;
+  };
+  worker_blocker blocker{sut};
+  for (int i = 0; i < 4; i++)
+    REQUIRE(sut.try_enqueue(&tasks[i]));
+
+  // Act
+  bool accepted = sut.enqueue_bounded(&overflow);
+
+  // Assert
+  REQUIRE(accepted);
+  REQUIRE(overflow.thread_ == std::this_thread::get_id());
+  // The calling thread doesn't belong to the pool; the task gets the index of the extra line.
+  REQUIRE(overflow.line_index_ == sut.max_parallelism());
+  REQUIRE(executed.load() == 0);
+  blocker.release();
+  wait_until([&] { return executed.load() == 4; });
+  sut.join();
+}
+
+TEST_CASE("thread_pool suspends producers until there is room, with suspend_producer policy",
+          "[thread_pool]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  using policy_t = concore2full::thread_pool::overflow_policy;
+  concore2full::thread_pool sut{
+      {.num_threads = 1, .max_pending_tasks = 4, .on_overflow = policy_t::suspend_producer}};
+  std::atomic<int> executed{0};
+  constexpr int num_tasks = 100;
+  std::vector<std_fun_task> tasks;
+  for (int i = 0; i < num_tasks; i++)
+    tasks.emplace_back([&executed] { executed++; });
+  worker_blocker blocker{sut};
+  for (int i = 0; i < 4; i++)
+    REQUIRE(sut.try_enqueue(&tasks[i]));
+
+  // Act: the only worker is blocked; the producer needs to make room itself, by helping the pool.
+  int executed_before_accepted = -1;
+  int num_accepted = 0;
+  std::thread producer{[&] {
+    num_accepted += sut.enqueue_bounded(&tasks[4]);
+    executed_before_accepted = executed.load();
+    for (int i = 5; i < num_tasks; i++)
+      num_accepted += sut.enqueue_bounded(&tasks[i]);
+  }};
+  producer.join();
+  blocker.release();
+  wait_until([&] { return executed.load() == num_tasks; });
+
+  // Assert
+  REQUIRE(num_accepted == num_tasks - 4);
+  REQUIRE(executed_before_accepted >= 1);
+  sut.join();
+}
@@ -0,0 +1,108 @@
+#include "concore2full/detail/timer_wheel.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using concore2full::detail::timer_wheel;
+
+namespace {
+//! Returns the indices (in `tasks`) of the tasks in the chain starting with `head`, sorted.
+std::vector<int> indices_of(concore2full_task* head, const std::vector<concore2full_task>& tasks) {
+  std::vector<int> res;
+  for (auto* cur = head; cur; cur = cur->next_)
+    res.push_back(static_cast<int>(cur - tasks.data()));
+  std::sort(res.begin(), res.end());
+  return res;
+}
+} // namespace
+
+TEST_CASE("timer_wheel: starts empty", "[timer_wheel]") {
+  // Arrange
+  timer_wheel sut;
+
+  // Assert
+  REQUIRE(sut.empty());
+  REQUIRE(sut.next_expiration() == timer_wheel::no_expiration);
+  REQUIRE(sut.advance(1000) == nullptr);
+  REQUIRE(sut.current_tick() == 1000);
+}
+
+TEST_CASE("timer_wheel: tasks with passed deadlines are not inserted", "[timer_wheel]") {
+  // Arrange
+  timer_wheel sut;
+  (void)sut.advance(10);
+  concore2full_task task{};
+
+  // Act & Assert
+  REQUIRE_FALSE(sut.insert(&task, 5));
+  REQUIRE_FALSE(sut.insert(&task, 10));
+  REQUIRE(sut.empty());
+}
+
+TEST_CASE("timer_wheel: tasks expire exactly at their deadlines", "[timer_wheel]") {
+  // Arrange: deadlines on all the levels of the wheel, and beyond its range.
+  timer_wheel sut;
+  std::vector<uint64_t> deadlines{1,       2,        63,          64,           65,
+                                  100,     4095,     4096,        4097,         300'000,
+                                  1 << 20, 20 << 20, 1ULL << 33,  (1ULL << 36) + 17};
+  std::vector<concore2full_task> tasks(deadlines.size());
+  for (size_t i = 0; i < deadlines.size(); i++)
+    REQUIRE(sut.insert(&tasks[i], deadlines[i]));
+  REQUIRE(sut.size() == static_cast<int>(deadlines.size()));
+
+  // Act & Assert: advance the wheel just before and at each deadline.
+  for (size_t i = 0; i < deadlines.size(); i++) {
+    REQUIRE(sut.next_expiration() <= deadlines[i]);
+    REQUIRE(sut.advance(deadlines[i] - 1) == nullptr);
+    auto* expired = sut.advance(deadlines[i]);
+    REQUIRE(indices_of(expired, tasks) == std::vector<int>{static_cast<int>(i)});
+  }
+  REQUIRE(sut.empty());
+  REQUIRE(sut.next_expiration() == timer_wheel::no_expiration);
+}
+
+TEST_CASE("timer_wheel: advancing over many ticks expires all the due tasks", "[timer_wheel]") {
+  // Arrange
+  timer_wheel sut;
+  (void)sut.advance(12'345);
+  constexpr int num_tasks = 1000;
+  std::vector<concore2full_task> tasks(num_tasks);
+  for (int i = 0; i < num_tasks; i++)
+    REQUIRE(sut.insert(&tasks[i], 12'346 + static_cast<uint64_t>(i) * 37));
+
+  // Act
+  auto* expired1 = sut.advance(12'345 + 500 * 37);
+  auto expired1_indices = indices_of(expired1, tasks);
+  auto* expired2 = sut.advance(1'000'000);
+  auto expired2_indices = indices_of(expired2, tasks);
+
+  // Assert
+  REQUIRE(expired1_indices.size() == 500);
+  REQUIRE(expired1_indices.back() == 499);
+  REQUIRE(expired2_indices.size() == 500);
+  REQUIRE(expired2_indices.front() == 500);
+  REQUIRE(sut.empty());
+}
+
+TEST_CASE("timer_wheel: tasks inserted after advancing expire at the right tick", "[timer_wheel]") {
+  // Arrange
+  timer_wheel sut;
+  concore2full_task t1{};
+  concore2full_task t2{};
+  (void)sut.advance(4000);
+  REQUIRE(sut.insert(&t1, 4100));
+  (void)sut.advance(4090);
+
+  // Act
+  REQUIRE(sut.insert(&t2, 4095));
+
+  // Assert
+  REQUIRE(sut.next_expiration() <= 4095);
+  REQUIRE(sut.advance(4095) == &t2);
+  REQUIRE(sut.advance(4099) == nullptr);
+  REQUIRE(sut.advance(4100) == &t1);
+  REQUIRE(sut.empty());
+}
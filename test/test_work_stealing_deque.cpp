@@ -0,0 +1,124 @@
+#include "concore2full/detail/work_stealing_deque.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using concore2full::detail::work_stealing_deque;
+
+TEST_CASE("work_stealing_deque: owner pops in LIFO order", "[work_stealing_deque]") {
+  // Arrange
+  work_stealing_deque sut{8};
+  concore2full_task tasks[3]{};
+
+  // Act
+  for (auto& t : tasks)
+    REQUIRE(sut.try_push(&t));
+
+  // Assert
+  REQUIRE(sut.pop() == &tasks[2]);
+  REQUIRE(sut.pop() == &tasks[1]);
+  REQUIRE(sut.pop() == &tasks[0]);
+  REQUIRE(sut.pop() == nullptr);
+  REQUIRE(sut.empty());
+}
+
+TEST_CASE("work_stealing_deque: thieves steal in FIFO order", "[work_stealing_deque]") {
+  // Arrange
+  work_stealing_deque sut{8};
+  concore2full_task tasks[3]{};
+
+  // Act
+  for (auto& t : tasks)
+    REQUIRE(sut.try_push(&t));
+
+  // Assert
+  REQUIRE(sut.steal() == &tasks[0]);
+  REQUIRE(sut.steal() == &tasks[1]);
+  REQUIRE(sut.pop() == &tasks[2]);
+  REQUIRE(sut.steal() == nullptr);
+}
+
+TEST_CASE("work_stealing_deque: push fails when the deque is full", "[work_stealing_deque]") {
+  // Arrange
+  work_stealing_deque sut{2};
+  concore2full_task tasks[3]{};
+
+  // Act / Assert
+  REQUIRE(sut.try_push(&tasks[0]));
+  REQUIRE(sut.try_push(&tasks[1]));
+  REQUIRE_FALSE(sut.try_push(&tasks[2]));
+  REQUIRE(sut.pop() == &tasks[1]);
+  REQUIRE(sut.try_push(&tasks[2]));
+}
+
+TEST_CASE("work_stealing_deque: extracted tasks are skipped", "[work_stealing_deque]") {
+  // Arrange
+  work_stealing_deque sut{8};
+  concore2full_task tasks[3]{};
+  for (auto& t : tasks)
+    REQUIRE(sut.try_push(&t));
+
+  // Act
+  bool res0 = work_stealing_deque::extract(&tasks[0]);
+  bool res2 = work_stealing_deque::extract(&tasks[2]);
+
+  // Assert
+  REQUIRE(res0);
+  REQUIRE(res2);
+  REQUIRE(sut.pop() == &tasks[1]);
+  REQUIRE(sut.pop() == nullptr);
+  REQUIRE(sut.steal() == nullptr);
+  // Cannot extract again.
+  REQUIRE_FALSE(work_stealing_deque::extract(&tasks[0]));
+  REQUIRE_FALSE(work_stealing_deque::extract(&tasks[1]));
+}
+
+TEST_CASE("work_stealing_deque: each task is taken exactly once under contention",
+          "[work_stealing_deque]") {
+  // Arrange
+  constexpr int num_tasks = 100'000;
+  constexpr int num_thieves = 3;
+  work_stealing_deque sut{256};
+  std::vector<concore2full_task> tasks(num_tasks);
+  std::vector<std::atomic<int>> taken(num_tasks);
+  std::atomic<bool> done{false};
+  auto take = [&](concore2full_task* t) { taken[t - tasks.data()]++; };
+
+  // Act
+  std::vector<std::thread> thieves;
+  for (int i = 0; i < num_thieves; i++) {
+    thieves.emplace_back([&] {
+      while (!done.load()) {
+        if (auto* t = sut.steal())
+          take(t);
+      }
+    });
+  }
+  for (int i = 0; i < num_tasks; i++) {
+    while (!sut.try_push(&tasks[i])) {
+      if (auto* t = sut.pop())
+        take(t);
+    }
+    // Sometimes extract the task, sometimes pop a task.
+    if (i % 3 == 0 && work_stealing_deque::extract(&tasks[i]))
+      take(&tasks[i]);
+    else if (i % 3 == 1) {
+      if (auto* t = sut.pop())
+        take(t);
+    }
+  }
+  while (auto* t = sut.pop())
+    take(t);
+  done = true;
+  for (auto& th : thieves)
+    th.join();
+
+  // Assert
+  int wrong = 0;
+  for (auto& v : taken)
+    wrong += v.load() != 1;
+  REQUIRE(wrong == 0);
+}
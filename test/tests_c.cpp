@@ -3,7 +3,19 @@
 extern "C" {
 int test_basic_spawn();
 int test_basic_bulk_spawn();
+int test_spawn_with_allocator();
+int test_spawn_with_mmap_allocator();
+int test_bulk_spawn_with_allocator();
+int test_stack_stats();
+int test_thread_pool_stats();
 }
 
 TEST_CASE("C: spawn basic test", "[c]") { REQUIRE(test_basic_spawn()); }
 TEST_CASE("C: bulk_spawn basic test", "[c]") { REQUIRE(test_basic_bulk_spawn()); }
+TEST_CASE("C: spawn with custom allocator", "[c]") { REQUIRE(test_spawn_with_allocator()); }
+TEST_CASE("C: spawn with mmap allocator", "[c]") { REQUIRE(test_spawn_with_mmap_allocator()); }
+TEST_CASE("C: bulk_spawn with custom allocator", "[c]") {
+  REQUIRE(test_bulk_spawn_with_allocator());
+}
+TEST_CASE("C: stack stats can be queried", "[c]") { REQUIRE(test_stack_stats()); }
+TEST_CASE("C: thread pool stats can be queried", "[c]") { REQUIRE(test_thread_pool_stats()); }
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "concore2full/profiling.h"
+#include "concore2full/thread_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstdio>
+#include <functional>
+#include <latch>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+//! Wait until `predicate` returns true, using the pool-waiting technique.
+//! Throws if `timeout` is reached.
+void wait_until(std::predicate auto predicate, std::chrono::milliseconds sleep_time = 1ms,
+                std::chrono::milliseconds timeout = 1s) {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  auto start_time = std::chrono::high_resolution_clock::now();
+  while (true) {
+    // If the predicate is true, we are done.
+    if (predicate())
+      return;
+    // Check for timeout.
+    if (std::chrono::high_resolution_clock::now() - start_time > timeout) {
+      printf("Timeout\n");
+      throw std::runtime_error("Timeout");
+    }
+    // Sleep for a while.
+    std::this_thread::sleep_for(sleep_time);
+  }
+}
+
+struct std_fun_task : concore2full_task {
+  std::function<void()> f_;
+  std_fun_task() = default;
+  explicit std_fun_task(std::function<void()> f) : f_(std::move(f)) {
+    task_function_ = &execute;
+    next_ = nullptr;
+  }
+
+  static void execute(concore2full_task* task, int) noexcept {
+    auto self = static_cast<std_fun_task*>(task);
+    std::invoke(self->f_);
+  }
+};
+
+//! Test that ensures that `pool` has at least `num_threads` parallelism.
+inline void ensure_parallelism(concore2full::thread_pool& pool, int num_threads) {
+  if (num_threads <= 2)
+    return;
+
+  // Arrange
+  std::atomic<int> tasks_started{0};
+  std::atomic<int> tasks_done{0};
+  auto core_task_fun = [&tasks_started, &tasks_done, num_threads]() {
+    (void)tasks_started.fetch_add(1, std::memory_order_release);
+    wait_until([&] { return tasks_started.load(std::memory_order_acquire) >= num_threads; });
+    (void)tasks_done.fetch_add(1, std::memory_order_release);
+  };
+  int num_tasks = 3 * num_threads;
+  std::vector<std_fun_task> tasks;
+  tasks.reserve(num_tasks);
+  for (int i = 0; i < num_tasks; i++) {
+    tasks.emplace_back(std::function<void()>([&core_task_fun] { core_task_fun(); }));
+  }
+
+  // Act
+  for (auto& t : tasks) {
+    pool.enqueue(&t);
+  }
+
+  // Assert
+  wait_until([&] { return tasks_done.load() >= num_tasks; });
+}
+
+//! Keeps one worker of a thread pool busy until `release()` is called.
+//!
+//! Blocking the only worker of a pool lets a test decide what the pool holds before any of it is
+//! executed. The destructor releases the worker, if the test didn't.
+class worker_blocker {
+public:
+  //! Blocks a worker of `pool`; returns once the worker executes the blocking task.
+  explicit worker_blocker(concore2full::thread_pool& pool) {
+    task_.task_function_ = &execute;
+    task_.next_ = nullptr;
+    pool.enqueue(&task_);
+    started_.wait();
+  }
+  ~worker_blocker() { release(); }
+
+  worker_blocker(const worker_blocker&) = delete;
+  worker_blocker& operator=(const worker_blocker&) = delete;
+
+  //! Lets the blocked worker continue, and waits until it is done with the blocking task.
+  void release() {
+    if (released_)
+      return;
+    released_ = true;
+    release_.count_down();
+    finished_.wait();
+  }
+
+private:
+  struct blocking_task : concore2full_task {
+    worker_blocker* owner_{nullptr};
+  };
+  blocking_task task_{{}, this};
+  std::latch started_{1};
+  std::latch release_{1};
+  std::latch finished_{1};
+  bool released_{false};
+
+  static void execute(concore2full_task* task, int) noexcept {
+    auto self = static_cast<blocking_task*>(task)->owner_;
+    self->started_.count_down();
+    self->release_.wait();
+    self->finished_.count_down();
+  }
+};